@@ -3,6 +3,9 @@
 in vec4 epos;
 in vec3 norm;
 in vec2 tc;
+flat in int layer;
+flat in int shaded;
+in float logw;
 
 out vec4 fragColor;
 
@@ -10,14 +13,20 @@ uniform mat4	view_matrix;
 uniform vec4	light_position, Ia, Id, Is;	// light
 uniform vec4	Ka, Kd, Ks;					// material properties
 uniform float	shininess;
-uniform bool	blinnEnabled;
 uniform bool	blendEnabled;
+uniform float	log_depth;	// 2/log2(far+1) for logarithmic depth; zero keeps the rasterized depth
 
-uniform sampler2D TEX1;
+uniform sampler2DArray TEX;	// planet surfaces or rings, one layer per texture
 
 void main()
 {
-	if(blinnEnabled)
+#ifdef LOG_DEPTH
+	// logarithmic depth is not linear in screen space, so it is evaluated per fragment, not interpolated;
+	// the define is added only in that mode, since writing the depth disables early depth tests
+	gl_FragDepth = log2(max(1e-6,logw))*0.5*log_depth;
+#endif
+
+	if(shaded!=0)
 	{
 		// light position in the eye-space coordinate
 		vec4 lpos = view_matrix*light_position;
@@ -32,9 +41,9 @@ void main()
 		vec4 Ird = max(Kd*dot(l,n)*Id,0.0);					// diffuse reflection
 		vec4 Irs = max(Ks*pow(dot(h,n),shininess)*Is,0.0);	// specular reflection
 
-		fragColor = texture2D(TEX1, tc) * (Ira + Ird + Irs);
+		fragColor = texture(TEX, vec3(tc, layer)) * (Ira + Ird + Irs);
 	} else {
-		fragColor = texture2D(TEX1, tc);
+		fragColor = texture(TEX, vec3(tc, layer));
 	}
 	if(blendEnabled)
 		fragColor.a = 0.5;
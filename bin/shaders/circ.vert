@@ -4,19 +4,30 @@ in vec3 position;
 in vec3 normal;
 in vec2 texcoord;
 
+in mat4 instance_model;	// per-instance model matrix
+in vec4 instance_info;	// per-instance x: texture layer, y: shaded (1) or emissive (0)
+in mat3 instance_normal;	// per-instance eye-space normal matrix
+
 out vec4 epos;	// eye-coordinate position
 out vec3 norm;	// per-vertex normal before interpolation
 out vec2 tc;
+flat out int layer;
+flat out int shaded;
+out float logw;	// 1+w for the logarithmic depth of each fragment
 
-uniform mat4 model_matrix;
 uniform mat4 view_matrix;
 uniform mat4 projection_matrix;
+uniform float log_depth;	// 2/log2(far+1) for logarithmic depth; zero keeps the projected depth
 
 void main()
 {
-	vec4 wpos = model_matrix * vec4(position, 1.0);
+	vec4 wpos = instance_model * vec4(position, 1.0);
 	epos = view_matrix * wpos;
-	norm = normalize(mat3(view_matrix*model_matrix)*normal);
+	norm = normalize(instance_normal*normal);
 	tc = texcoord;
+	layer = int(instance_info.x);
+	shaded = int(instance_info.y);
 	gl_Position = projection_matrix * epos;
+	logw = 1.0+gl_Position.w;
+	if(log_depth>0.0) gl_Position.z = (log2(max(1e-6,logw))*log_depth-1.0)*gl_Position.w;	// for clipping; the fragments write their own depth
 }
\ No newline at end of file
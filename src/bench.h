@@ -0,0 +1,112 @@
+#pragma once
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+//*******************************************************************
+// offline benchmark (--bench): frames are driven by a frame counter instead of the wall clock, so the
+// camera flight and the fixed simulation steps are the same in every run; after a few warm-up frames,
+// the CPU time of each frame, the GPU time of its commands, and its draw calls are recorded, and the
+// summary is printed as one line of JSON to compare builds
+// the GPU time of a frame is the difference of two GL_TIMESTAMP queries, which unlike GL_TIME_ELAPSED
+// may enclose the timer queries of the profiler
+static const int	BENCH_QUERY_LAG = 3;	// frames between a timer query and reading its result, so reading never stalls
+
+struct frame_bench
+{
+	int		frames = 0;				// recorded frames; zero when not benchmarking
+	int		warmup = 10;			// frames run before recording, e.g., for shader compilation in the driver
+	double	frame_time = 1.0 / 60;	// fixed wall-clock time per frame
+	int		frame = 0;				// frames begun, including warm-up
+	GLuint	queries[BENCH_QUERY_LAG + 1][2];	// timestamps at the beginning and the end of a frame
+	std::vector<double>	cpu_ms, gpu_ms;
+	std::vector<uint>	draw_calls;
+	std::chrono::high_resolution_clock::time_point	cpu_start;
+
+	frame_bench(){ memset(queries, 0, sizeof(queries)); }	// VS2013 has no in-class array initializers
+
+	inline bool active() const { return frames > 0; }
+	inline bool done() const { return frame >= warmup + frames; }
+	inline double time() const { return frame*frame_time; }	// replaces glfwGetTime() for the simulation clock
+	inline float progress() const { return float(max(0, frame - warmup)) / float(frames); }	// [0,1) along the camera flight
+
+	// timer queries need GL 3.3; GPU times are left out without them
+	void create(int frame_count)
+	{
+		frames = frame_count; frame = 0;
+		cpu_ms.clear(); gpu_ms.clear(); draw_calls.clear();
+		if(GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query) glGenQueries((BENCH_QUERY_LAG + 1) * 2, queries[0]);
+		else printf("[warning] no timer queries; GPU times are not measured\n");
+	}
+
+	void release()
+	{
+		if(queries[0][0]) glDeleteQueries((BENCH_QUERY_LAG + 1) * 2, queries[0]);
+		memset(queries, 0, sizeof(queries));
+	}
+
+	void begin_frame()
+	{
+		cpu_start = std::chrono::high_resolution_clock::now();
+		if(queries[0][0] && frame >= warmup) glQueryCounter(queries[(frame - warmup) % (BENCH_QUERY_LAG + 1)][0], GL_TIMESTAMP);
+	}
+
+	// the query of a frame is read BENCH_QUERY_LAG frames later, and the last ones at report()
+	void end_frame(uint draw_call_count)
+	{
+		if(frame++ < warmup) return;
+		if(queries[0][0]) glQueryCounter(queries[(frame - warmup - 1) % (BENCH_QUERY_LAG + 1)][1], GL_TIMESTAMP);
+		cpu_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cpu_start).count());
+		draw_calls.push_back(draw_call_count);
+		if(queries[0][0] && cpu_ms.size() > BENCH_QUERY_LAG) read_query(cpu_ms.size() - BENCH_QUERY_LAG - 1);
+	}
+
+	void read_query(size_t index)
+	{
+		GLuint64 t[2] = { 0, 0 }; const GLuint* q = queries[index % (BENCH_QUERY_LAG + 1)];
+		glGetQueryObjectui64v(q[0], GL_QUERY_RESULT, &t[0]); glGetQueryObjectui64v(q[1], GL_QUERY_RESULT, &t[1]);
+		gpu_ms.push_back((t[1] - t[0]) / 1e6);
+	}
+
+	// nearest-rank percentile of p in [0,1]
+	static double percentile(std::vector<double> v, double p)
+	{
+		if(v.empty()) return 0;
+		std::sort(v.begin(), v.end());
+		size_t rank = size_t(ceil(p*v.size())); return v[rank > 0 ? rank - 1 : 0];
+	}
+
+	static void print_stats(const char* name, const std::vector<double>& v)
+	{
+		double sum = 0; for(double x : v) sum += x;
+		printf("\"%s\":{\"min\":%.3f,\"avg\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}", name, percentile(v, 0), v.empty() ? 0 : sum / v.size(), percentile(v, 0.95), percentile(v, 0.99), percentile(v, 1));
+	}
+
+	// one line of JSON; the scene is described by the caller, and the phases of an enabled profiler are added
+	void report(const char* scene, size_t bodies, const profiler* prof = nullptr)
+	{
+		while(queries[0][0] && gpu_ms.size() < cpu_ms.size()) read_query(gpu_ms.size());
+		std::vector<double> draws(draw_calls.begin(), draw_calls.end());
+		printf("{\"bench\":\"%s\",\"bodies\":%d,\"frames\":%d,", scene, int(bodies), int(cpu_ms.size()));
+		print_stats("cpu_ms", cpu_ms); printf(",");
+		if(queries[0][0]){ print_stats("gpu_ms", gpu_ms); printf(","); }
+		print_stats("draw_calls", draws);
+		if(prof && prof->enabled){ printf(","); prof->print_json(); }
+		printf("}\n");
+		fflush(stdout);
+	}
+};
+
+// scripted flight around the origin in the orbital plane (xy): one loop per run, swooping in to half
+// the radius twice and rising above and below the plane, always looking at the sun; the far plane
+// grows to keep the far side of a large scene in view
+inline void bench_flight(camera& cam, float u, double radius)
+{
+	cam.dFar = max(cam.dFar, float(radius*2.5));
+	double a = 2 * PI*u, r = radius*(0.75 + 0.25*cos(4 * PI*u));
+	cam.origin = dvec3(r*cos(a), r*sin(a), radius*0.25*sin(a));
+	cam.eye = vec3(0.0f);
+	cam.at = vec3(float(-cam.origin.x), float(-cam.origin.y), float(-cam.origin.z)).normalize();
+	cam.up = vec3(0.0f, 0.0f, 1.0f);
+}
+
+#endif // __BENCH_H__
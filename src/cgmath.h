@@ -14,17 +14,28 @@
 // STL
 #include <algorithm>
 #include <array>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
 // C++11
 #if (_MSC_VER>=1600/*VS2010*/) || (__cplusplus>199711L)
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #endif
+// SIMD: SSE2 kernels for mat4/vec4 unless CGMATH_NO_SIMD is defined (SSE2 is the x64 and VS2013 x86 baseline)
+#if !defined(CGMATH_NO_SIMD)&&(defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2))
+#define CGMATH_SSE 1
+#include <emmintrin.h>
+#endif
 // windows/GCC
 #if !defined(__GNUC__)&&(defined(_WIN32)||defined(_WIN64))
 #include <windows.h>
@@ -55,6 +66,43 @@ typedef unsigned int	uint;
 typedef unsigned short	ushort;
 typedef unsigned char	uchar;
 
+//*******************************************************************
+// aligned storage: e.g., std::vector<mat4,aligned_allocator<mat4>> keeps every element on a 16-byte boundary
+inline void* aligned_malloc(size_t size, size_t alignment = 16)
+{
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, alignment);
+#else
+	void* p = nullptr; return posix_memalign(&p, max(alignment, sizeof(void*)), size) == 0 ? p : nullptr;
+#endif
+}
+
+inline void aligned_free(void* p)
+{
+#if defined(_MSC_VER)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+template <class T, size_t A = 16> struct aligned_allocator
+{
+	typedef T value_type; typedef T* pointer; typedef const T* const_pointer; typedef T& reference; typedef const T& const_reference;
+	typedef size_t size_type; typedef ptrdiff_t difference_type;
+	template <class U> struct rebind { typedef aligned_allocator<U, A> other; };
+
+	aligned_allocator(){}
+	template <class U> aligned_allocator(const aligned_allocator<U, A>&){}
+	inline T* allocate(size_t n){ T* p = (T*) aligned_malloc(n*sizeof(T), A); if(!p) throw std::bad_alloc(); return p; }
+	inline void deallocate(T* p, size_t){ aligned_free(p); }
+	inline size_t max_size() const { return size_t(-1) / sizeof(T); }
+	template <class U> inline void destroy(U* p){ p->~U(); }
+	template <class U, class... Args> inline void construct(U* p, Args&&... args){ ::new((void*) p) U(std::forward<Args>(args)...); }
+	inline bool operator==(const aligned_allocator&) const { return true; }
+	inline bool operator!=(const aligned_allocator&) const { return false; }
+};
+
 // template constants
 template <class T> struct precision { static const T value(){ return std::numeric_limits<T>::epsilon() * 10; } };	// need to be 10x for robust practical test
 
@@ -253,6 +301,20 @@ using ivec2 = tvec2<int>;		using ivec3 = tvec3<int>;		using ivec4 = tvec4<int>;
 using uvec2 = tvec2<uint>;		using uvec3 = tvec3<uint>;		using uvec4 = tvec4<uint>;
 using dvec2 = tvec2<double>;	using dvec3 = tvec3<double>;	using dvec4 = tvec4<double>;
 
+#ifdef CGMATH_SSE
+//*******************************************************************
+// SSE specializations of vec4 arithmetic: unaligned loads, so any vec4 in memory qualifies
+__forceinline __m128 sse_load(const vec4& v){ return _mm_loadu_ps(&v.x); }
+__forceinline vec4 sse_store(__m128 m){ vec4 v; _mm_storeu_ps(&v.x, m); return v; }
+__forceinline float sse_hsum(__m128 m){ m = _mm_add_ps(m, _mm_movehl_ps(m, m)); return _mm_cvtss_f32(_mm_add_ss(m, _mm_shuffle_ps(m, m, 1))); }
+template <> inline vec4 vec4::operator+(const vec4& v) const { return sse_store(_mm_add_ps(sse_load(*this), sse_load(v))); }
+template <> inline vec4 vec4::operator-(const vec4& v) const { return sse_store(_mm_sub_ps(sse_load(*this), sse_load(v))); }
+template <> inline vec4 vec4::operator*(const vec4& v) const { return sse_store(_mm_mul_ps(sse_load(*this), sse_load(v))); }
+template <> inline vec4 vec4::operator/(const vec4& v) const { return sse_store(_mm_div_ps(sse_load(*this), sse_load(v))); }
+template <> inline vec4 vec4::operator*(float f) const { return sse_store(_mm_mul_ps(sse_load(*this), _mm_set1_ps(f))); }
+template <> inline float vec4::dot(const vec4& v) const { return sse_hsum(_mm_mul_ps(sse_load(*this), sse_load(v))); }
+#endif
+
 //*******************************************************************
 // matrix 3x3: uses a standard row-major notation
 struct mat3
@@ -343,7 +405,11 @@ struct mat4
 	// identity and transpose
 	static mat4 identity(){ return mat4(); }
 	inline void setIdentity(){ _12 = _13 = _14 = _21 = _23 = _24 = _31 = _32 = _34 = _41 = _42 = _43 = 0.0f; _11 = _22 = _33 = _44 = 1.0f; }
+#ifdef CGMATH_SSE
+	inline mat4 transpose() const { __m128 r0 = _mm_loadu_ps(a), r1 = _mm_loadu_ps(a + 4), r2 = _mm_loadu_ps(a + 8), r3 = _mm_loadu_ps(a + 12); _MM_TRANSPOSE4_PS(r0, r1, r2, r3); mat4 m; _mm_storeu_ps(m.a, r0); _mm_storeu_ps(m.a + 4, r1); _mm_storeu_ps(m.a + 8, r2); _mm_storeu_ps(m.a + 12, r3); return m; }
+#else
 	inline mat4 transpose() const { return mat4(_11, _21, _31, _41, _12, _22, _32, _42, _13, _23, _33, _43, _14, _24, _34, _44); }
+#endif
 
 	// addition/subtraction operators
 	inline mat4 operator+(const mat4& m) const { mat4 r; for (int k = 0; k < std::extent<decltype(a)>::value; k++) r[k] = a[k] + m[k]; return r; }
@@ -353,8 +419,13 @@ struct mat4
 
 	// multiplication operators
 	inline mat4 operator*(float f) const { mat4 r; for (int k = 0; k < std::extent<decltype(a)>::value; k++) r[k] = a[k] * f; return r; }
+#ifdef CGMATH_SSE
+	inline vec4 operator*(const vec4& v) const;		// SSE versions: see below
+	inline mat4 operator*(const mat4& m) const;
+#else
 	inline vec4 operator*(const vec4& v) const { return vec4(rvec4(0).dot(v), rvec4(1).dot(v), rvec4(2).dot(v), rvec4(3).dot(v)); }
 	inline mat4 operator*(const mat4& m) const { mat4 t = m.transpose(), r; for (uint k = 0; k<4; k++) r.rvec4(k) = t.operator*(rvec4(k)); return r; } // a bit tricky implementation
+#endif
 	inline mat4& operator*=(const mat4& m){ return *this = operator*(m); }
 
 	// determinant and inverse: see below for implementations
@@ -372,6 +443,7 @@ struct mat4
 	static mat4 rotate(const vec3& axis, float angle){ return mat4().setRotate(axis, angle); }
 	static mat4 lookAt(const vec3& eye, const vec3& at, const vec3& up){ return mat4().setLookAt(eye, at, up); }
 	static mat4 perspective(float fovy, float aspectRatio, float dNear, float dFar){ return mat4().setPerspective(fovy, aspectRatio, dNear, dFar); }
+	static mat4 perspectiveReversed(float fovy, float aspectRatio, float dNear){ return mat4().setPerspectiveReversed(fovy, aspectRatio, dNear); }
 
 	// row-major transformations
 	inline mat4& setTranslate(const vec3& v){ setIdentity(); _14 = v.x; _24 = v.y; _34 = v.z; return *this; }
@@ -421,6 +493,21 @@ struct mat4
 
 		return *this;
 	}
+
+	// reversed-Z with an infinite far plane for the [0,1] clip range (glClipControl): depth is dNear/distance,
+	// so near maps to 1 and infinity to 0, which spreads float depth evenly over orders of magnitude
+	mat4& setPerspectiveReversed(float fovy, float aspectRatio, float dNear)
+	{
+		setIdentity();
+		_22 = 1 / tan(fovy / 2.0f);
+		_11 = _22 / aspectRatio;
+		_33 = 0;
+		_34 = dNear;
+		_43 = -1;
+		_44 = 0;
+
+		return *this;
+	}
 };
 
 inline float mat4::determinant() const
@@ -434,6 +521,74 @@ inline float mat4::determinant() const
 		_31 * _12 * _23 * _44 - _11 * _32 * _23 * _44 - _21 * _12 * _33 * _44 + _11 * _22 * _33 * _44;
 }
 
+#ifdef CGMATH_SSE
+// each row of the product is a linear combination of the rows of m
+inline mat4 mat4::operator*(const mat4& m) const
+{
+	__m128 m0 = _mm_loadu_ps(m.a), m1 = _mm_loadu_ps(m.a + 4), m2 = _mm_loadu_ps(m.a + 8), m3 = _mm_loadu_ps(m.a + 12); mat4 r;
+	for(int k = 0; k < 16; k += 4)
+	{
+		__m128 row = _mm_loadu_ps(a + k);
+		__m128 v = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), m0);
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(row, row, 0x55), m1));
+		v = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xaa), m2)), _mm_mul_ps(_mm_shuffle_ps(row, row, 0xff), m3));
+		_mm_storeu_ps(r.a + k, v);
+	}
+	return r;
+}
+
+// four row products transposed and summed, so that the dot products finish in one register
+inline vec4 mat4::operator*(const vec4& v) const
+{
+	__m128 x = _mm_loadu_ps(&v.x);
+	__m128 r0 = _mm_mul_ps(_mm_loadu_ps(a), x), r1 = _mm_mul_ps(_mm_loadu_ps(a + 4), x), r2 = _mm_mul_ps(_mm_loadu_ps(a + 8), x), r3 = _mm_mul_ps(_mm_loadu_ps(a + 12), x);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	return sse_store(_mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+}
+
+// 2x2 block helpers for the SSE inverse; a 2x2 matrix is packed row-major into one register
+#define CGMATH_SHUFFLE(v1,v2,x,y,z,w)	_mm_shuffle_ps(v1,v2,(x)|((y)<<2)|((z)<<4)|((w)<<6))
+#define CGMATH_SWIZZLE(v,x,y,z,w)		CGMATH_SHUFFLE(v,v,x,y,z,w)
+__forceinline __m128 sse_mat2_mul(__m128 a, __m128 b){ return _mm_add_ps(_mm_mul_ps(a, CGMATH_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(CGMATH_SWIZZLE(a, 1, 0, 3, 2), CGMATH_SWIZZLE(b, 2, 1, 2, 1))); }		// A*B
+__forceinline __m128 sse_mat2_adj_mul(__m128 a, __m128 b){ return _mm_sub_ps(_mm_mul_ps(CGMATH_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(CGMATH_SWIZZLE(a, 1, 1, 2, 2), CGMATH_SWIZZLE(b, 2, 3, 0, 1))); }	// adj(A)*B
+__forceinline __m128 sse_mat2_mul_adj(__m128 a, __m128 b){ return _mm_sub_ps(_mm_mul_ps(a, CGMATH_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(CGMATH_SWIZZLE(a, 1, 0, 3, 2), CGMATH_SWIZZLE(b, 2, 1, 2, 1))); }	// A*adj(B)
+
+// block-wise inverse of [A B; C D] with 2x2 adjugates instead of 4x4 cofactors
+inline mat4 mat4::inverse() const
+{
+	__m128 r0 = _mm_loadu_ps(a), r1 = _mm_loadu_ps(a + 4), r2 = _mm_loadu_ps(a + 8), r3 = _mm_loadu_ps(a + 12);
+	__m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0), C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+
+	// determinants of the blocks as (|A| |B| |C| |D|)
+	__m128 det_sub = _mm_sub_ps(_mm_mul_ps(CGMATH_SHUFFLE(r0, r2, 0, 2, 0, 2), CGMATH_SHUFFLE(r1, r3, 1, 3, 1, 3)), _mm_mul_ps(CGMATH_SHUFFLE(r0, r2, 1, 3, 1, 3), CGMATH_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 det_a = CGMATH_SWIZZLE(det_sub, 0, 0, 0, 0), det_b = CGMATH_SWIZZLE(det_sub, 1, 1, 1, 1), det_c = CGMATH_SWIZZLE(det_sub, 2, 2, 2, 2), det_d = CGMATH_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+	__m128 d_c = sse_mat2_adj_mul(D, C), a_b = sse_mat2_adj_mul(A, B);
+	__m128 X = _mm_sub_ps(_mm_mul_ps(det_d, A), sse_mat2_mul(B, d_c));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(det_a, D), sse_mat2_mul(C, a_b));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(det_b, C), sse_mat2_mul_adj(D, a_b));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(det_c, B), sse_mat2_mul_adj(A, d_c));
+
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+	__m128 tr = _mm_mul_ps(a_b, CGMATH_SWIZZLE(d_c, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, CGMATH_SWIZZLE(tr, 2, 3, 0, 1)); tr = _mm_add_ps(tr, CGMATH_SWIZZLE(tr, 1, 0, 3, 2));
+	__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+	if(_mm_cvtss_f32(det) == 0) printf("mat4::inverse() might be singular.\n");
+
+	__m128 rdet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+	X = _mm_mul_ps(X, rdet); Y = _mm_mul_ps(Y, rdet); Z = _mm_mul_ps(Z, rdet); W = _mm_mul_ps(W, rdet);
+
+	// adjugate the blocks while storing
+	mat4 m;
+	_mm_storeu_ps(m.a, CGMATH_SHUFFLE(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(m.a + 4, CGMATH_SHUFFLE(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(m.a + 8, CGMATH_SHUFFLE(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(m.a + 12, CGMATH_SHUFFLE(Z, W, 2, 0, 2, 0));
+	return m;
+}
+#undef CGMATH_SHUFFLE
+#undef CGMATH_SWIZZLE
+#else
 inline mat4 mat4::inverse() const
 {
 	float det = determinant(), s = 1.0f / det; if (det == 0) printf("mat4::inverse() might be singular.\n");
@@ -457,6 +612,266 @@ inline mat4 mat4::inverse() const
 		(_41*_22*_13 - _21*_42*_13 - _41*_12*_23 + _11*_42*_23 + _21*_12*_43 - _11*_22*_43)*s,
 		(_21*_32*_13 - _31*_22*_13 + _31*_12*_23 - _11*_32*_23 - _21*_12*_33 + _11*_22*_33)*s);
 }
+#endif
+
+//*******************************************************************
+// unit quaternion for rotations: (x,y,z) = axis*sin(angle/2), w = cos(angle/2)
+struct quat
+{
+	float x, y, z, w;
+
+	quat(){ x = y = z = 0.0f; w = 1.0f; }
+	quat(float _x, float _y, float _z, float _w){ x = _x; y = _y; z = _z; w = _w; }
+
+	static quat identity(){ return quat(); }
+	static quat rotate(const vec3& axis, float angle){ float s = sin(angle*0.5f); return quat(axis.x*s, axis.y*s, axis.z*s, cos(angle*0.5f)); }	// axis must be normalized
+	static quat rotateZ(float angle){ return quat(0, 0, sin(angle*0.5f), cos(angle*0.5f)); }
+
+	// composition: (a*b) rotates by b first, then by a, as with matrices
+	inline quat operator*(const quat& q) const { return quat(w*q.x + x*q.w + y*q.z - z*q.y, w*q.y - x*q.z + y*q.w + z*q.x, w*q.z + x*q.y - y*q.x + z*q.w, w*q.w - x*q.x - y*q.y - z*q.z); }
+	inline quat& operator*=(const quat& q){ return *this = operator*(q); }
+	inline quat conjugate() const { return quat(-x, -y, -z, w); }
+	inline quat inverse() const { return conjugate(); }	// unit quaternions only
+	inline float length() const { return sqrt(x*x + y*y + z*z + w*w); }
+	inline quat normalize() const { float s = 1.0f / length(); return quat(x*s, y*s, z*s, w*s); }
+
+	// rotate a vector: v + 2w(u x v) + 2u x (u x v) with u = (x,y,z)
+	inline vec3 rotate(const vec3& v) const { vec3 u(x, y, z), t = (u^v)*2.0f; return v + t*w + (u^t); }
+
+	inline mat3 toMat3() const
+	{
+		float xx = x*x, yy = y*y, zz = z*z, xy = x*y, xz = x*z, yz = y*z, wx = w*x, wy = w*y, wz = w*z;
+		return mat3(1 - 2 * (yy + zz), 2 * (xy - wz), 2 * (xz + wy), 2 * (xy + wz), 1 - 2 * (xx + zz), 2 * (yz - wx), 2 * (xz - wy), 2 * (yz + wx), 1 - 2 * (xx + yy));
+	}
+};
+
+// spherical interpolation along the shorter arc
+inline quat slerp(const quat& a, quat b, float t)
+{
+	float d = a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w; if(d < 0){ d = -d; b = quat(-b.x, -b.y, -b.z, -b.w); }
+	float s0 = 1 - t, s1 = t;
+	if(d < 0.9995f){ float theta = acos(d), st = sin(theta); s0 = sin(s0*theta) / st; s1 = sin(s1*theta) / st; }
+	return quat(a.x*s0 + b.x*s1, a.y*s0 + b.y*s1, a.z*s0 + b.z*s1, a.w*s0 + b.w*s1).normalize();
+}
+
+//*******************************************************************
+// compact transform T*R*S with uniform scale: 8 floats instead of 16, closed under composition and inversion
+struct trs
+{
+	vec3	t;			// translation
+	float	s = 1.0f;	// uniform scale
+	quat	r;			// rotation
+
+	trs(){}
+	trs(const vec3& translation, const quat& rotation, float scale = 1.0f){ t = translation; r = rotation; s = scale; }
+
+	static trs translate(const vec3& v){ return trs(v, quat()); }
+	static trs translate(float x, float y, float z){ return trs(vec3(x, y, z), quat()); }
+	static trs rotate(const vec3& axis, float angle){ return trs(vec3(0.0f), quat::rotate(axis, angle)); }
+	static trs rotateZ(float angle){ return trs(vec3(0.0f), quat::rotateZ(angle)); }
+	static trs scale(float f){ return trs(vec3(0.0f), quat(), f); }
+
+	// parent*child: applies child first, as with matrices
+	inline trs operator*(const trs& c) const { return trs(t + r.rotate(c.t)*s, r*c.r, s*c.s); }
+	inline trs& operator*=(const trs& c){ return *this = operator*(c); }
+	inline trs inverse() const { quat ri = r.conjugate(); float si = 1.0f / s; return trs(-ri.rotate(t)*si, ri, si); }
+
+	inline vec3 transformPoint(const vec3& p) const { return t + r.rotate(p)*s; }
+	inline vec3 transformVector(const vec3& v) const { return r.rotate(v)*s; }
+
+	// expand to a row-major matrix only where a full matrix is needed, e.g., at upload
+	inline mat4 toMat4() const
+	{
+		mat3 m = r.toMat3();
+		return mat4(m._11*s, m._12*s, m._13*s, t.x, m._21*s, m._22*s, m._23*s, t.y, m._31*s, m._32*s, m._33*s, t.z, 0, 0, 0, 1);
+	}
+};
+
+//*******************************************************************
+// batched transforms about the z axis: Rz(parent_revolve*t)*T(parent_distance)*Rz(revolve*t)*T(distance)*Rz(rotate*t)*S(radius)
+// collapses to a single z rotation by the summed angles plus a translation, so each body costs three sincos:
+// the parent orbit and the orbit for the translation, and the summed angle for the rotation
+template <class T> struct torbit_batch
+{
+	std::vector<T>	radius, rotate, revolve, distance;	// per body, as in struct planet
+	std::vector<T>	parent_distance, parent_revolve;	// orbit of the parent; zero for bodies around the origin
+
+	inline size_t size() const { return radius.size(); }
+	inline void clear(){ radius.clear(); rotate.clear(); revolve.clear(); distance.clear(); parent_distance.clear(); parent_revolve.clear(); }
+	inline void push_back(T r, T rot, T rev, T dist, T pdist = 0, T prev = 0){ radius.push_back(r); rotate.push_back(rot); revolve.push_back(rev); distance.push_back(dist); parent_distance.push_back(pdist); parent_revolve.push_back(prev); }
+};
+using orbit_batch = torbit_batch<float>;	using dorbit_batch = torbit_batch<double>;
+
+#ifdef CGMATH_SSE
+// four-wide sincos: Cody-Waite reduction to [-pi/4,pi/4] and minimax polynomials (Cephes), about 1e-7 absolute error
+__forceinline void sse_sincos(__m128 x, __m128& s, __m128& c)
+{
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));	// nearest multiple of pi/2
+	__m128 qf = _mm_cvtepi32_ps(q);
+	__m128 r = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f))), _mm_mul_ps(qf, _mm_set1_ps(4.837512969970703125e-4f))), _mm_mul_ps(qf, _mm_set1_ps(7.549789948768648e-8f)));
+	__m128 r2 = _mm_mul_ps(r, r);
+	__m128 ps = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r2), _mm_set1_ps(8.3321608736e-3f)), r2), _mm_set1_ps(-1.6666654611e-1f));
+	ps = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(ps, r2), r));
+	__m128 pc = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r2), _mm_set1_ps(-1.388731625493765e-3f)), r2), _mm_set1_ps(4.166664568298827e-2f));
+	pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_mul_ps(_mm_mul_ps(pc, r2), r2));
+
+	// quadrant q: swap sin/cos for odd q, negate sin for q=2,3 and cos for q=1,2
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sign_s = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+	__m128 sign_c = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sign_s);
+	c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), sign_c);
+}
+
+// two-wide double sincos with the double-precision Cephes coefficients, about 1e-16 absolute error for |x| < 1e6
+__forceinline void sse_sincos(__m128d x, __m128d& s, __m128d& c)
+{
+	__m128i q = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(0.63661977236758134308)));	// nearest multiple of pi/2 in the low two lanes
+	__m128d qf = _mm_cvtepi32_pd(q);
+	__m128d r = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(qf, _mm_set1_pd(1.57079625129699707031))), _mm_mul_pd(qf, _mm_set1_pd(7.54978941586159635336e-8))), _mm_mul_pd(qf, _mm_set1_pd(5.39030285815811905290e-15)));
+	__m128d r2 = _mm_mul_pd(r, r);
+	__m128d ps = _mm_set1_pd(1.58962301576546568060e-10);
+	ps = _mm_add_pd(_mm_mul_pd(ps, r2), _mm_set1_pd(-2.50507477628578072866e-8));
+	ps = _mm_add_pd(_mm_mul_pd(ps, r2), _mm_set1_pd(2.75573136213857245213e-6));
+	ps = _mm_add_pd(_mm_mul_pd(ps, r2), _mm_set1_pd(-1.98412698295895385996e-4));
+	ps = _mm_add_pd(_mm_mul_pd(ps, r2), _mm_set1_pd(8.33333333332211858878e-3));
+	ps = _mm_add_pd(_mm_mul_pd(ps, r2), _mm_set1_pd(-1.66666666666666307295e-1));
+	ps = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(ps, r2), r));
+	__m128d pc = _mm_set1_pd(-1.13585365213876817300e-11);
+	pc = _mm_add_pd(_mm_mul_pd(pc, r2), _mm_set1_pd(2.08757008419747316778e-9));
+	pc = _mm_add_pd(_mm_mul_pd(pc, r2), _mm_set1_pd(-2.75573141792967388112e-7));
+	pc = _mm_add_pd(_mm_mul_pd(pc, r2), _mm_set1_pd(2.48015872888517045348e-5));
+	pc = _mm_add_pd(_mm_mul_pd(pc, r2), _mm_set1_pd(-1.38888888888730564116e-3));
+	pc = _mm_add_pd(_mm_mul_pd(pc, r2), _mm_set1_pd(4.16666666666665929218e-2));
+	pc = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(r2, _mm_set1_pd(0.5))), _mm_mul_pd(_mm_mul_pd(pc, r2), r2));
+
+	// spread q over both halves of each 64-bit lane, then select as in the float version; signs go to the high halves only
+	__m128i qq = _mm_shuffle_epi32(q, _MM_SHUFFLE(1, 1, 0, 0)), hi = _mm_set_epi32(int(0x80000000), 0, int(0x80000000), 0);
+	__m128d swap = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(qq, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128d sign_s = _mm_castsi128_pd(_mm_and_si128(_mm_slli_epi32(_mm_and_si128(qq, _mm_set1_epi32(2)), 30), hi));
+	__m128d sign_c = _mm_castsi128_pd(_mm_and_si128(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(qq, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30), hi));
+	s = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, pc), _mm_andnot_pd(swap, ps)), sign_s);
+	c = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, ps), _mm_andnot_pd(swap, pc)), sign_c);
+}
+#endif
+
+// write the model matrices of all bodies at time t to out, advancing by stride bytes per body
+// column_major stores each matrix transposed, ready for GL attribute/uniform upload
+inline void compose_orbits(const orbit_batch& b, float t, float* out, size_t stride = sizeof(float) * 16, bool column_major = false)
+{
+	size_t k = 0, n = b.size(); char* dst = (char*) out;
+#ifdef CGMATH_SSE
+	__m128 vt = _mm_set1_ps(t), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	for(; k + 4 <= n; k += 4)
+	{
+		__m128 radius = _mm_loadu_ps(&b.radius[k]), revolve = _mm_loadu_ps(&b.revolve[k]), distance = _mm_loadu_ps(&b.distance[k]);
+		__m128 parent_revolve = _mm_loadu_ps(&b.parent_revolve[k]), parent_distance = _mm_loadu_ps(&b.parent_distance[k]);
+		__m128 parent_angle = _mm_mul_ps(parent_revolve, vt), orbit_angle = _mm_add_ps(parent_angle, _mm_mul_ps(revolve, vt));
+		__m128 spin_angle = _mm_add_ps(orbit_angle, _mm_mul_ps(_mm_loadu_ps(&b.rotate[k]), vt));
+
+		__m128 sp, cp, so, co, ss, cs;
+		sse_sincos(parent_angle, sp, cp); sse_sincos(orbit_angle, so, co); sse_sincos(spin_angle, ss, cs);
+		__m128 tx = _mm_add_ps(_mm_mul_ps(parent_distance, cp), _mm_mul_ps(distance, co));
+		__m128 ty = _mm_add_ps(_mm_mul_ps(parent_distance, sp), _mm_mul_ps(distance, so));
+		__m128 rc = _mm_mul_ps(radius, cs), rs = _mm_mul_ps(radius, ss), nrs = _mm_sub_ps(zero, rs);
+
+		// rows are (rc,-rs,0,tx) (rs,rc,0,ty) (0,0,r,0) (0,0,0,1); transposing each group of four lanes yields one row (or column) per body
+		__m128 g0[4] = { rc, nrs, zero, tx }, g1[4] = { rs, rc, zero, ty }, g2[4] = { zero, zero, radius, zero }, g3[4] = { zero, zero, zero, one };
+		if(column_major){ g0[1] = rs; g0[3] = zero; g1[0] = nrs; g1[3] = zero; g3[0] = tx; g3[1] = ty; }
+		_MM_TRANSPOSE4_PS(g0[0], g0[1], g0[2], g0[3]); _MM_TRANSPOSE4_PS(g1[0], g1[1], g1[2], g1[3]);
+		_MM_TRANSPOSE4_PS(g2[0], g2[1], g2[2], g2[3]); _MM_TRANSPOSE4_PS(g3[0], g3[1], g3[2], g3[3]);
+		for(int j = 0; j < 4; j++, dst += stride)
+		{
+			float* m = (float*) dst;
+			_mm_storeu_ps(m, g0[j]); _mm_storeu_ps(m + 4, g1[j]); _mm_storeu_ps(m + 8, g2[j]); _mm_storeu_ps(m + 12, g3[j]);
+		}
+	}
+#endif
+	for(; k < n; k++, dst += stride)
+	{
+		float parent_angle = b.parent_revolve[k] * t, orbit_angle = parent_angle + b.revolve[k] * t, spin_angle = orbit_angle + b.rotate[k] * t;
+		float tx = b.parent_distance[k] * cos(parent_angle) + b.distance[k] * cos(orbit_angle);
+		float ty = b.parent_distance[k] * sin(parent_angle) + b.distance[k] * sin(orbit_angle);
+		float r = b.radius[k], rc = r*cos(spin_angle), rs = r*sin(spin_angle);
+		mat4 m(rc, -rs, 0, tx, rs, rc, 0, ty, 0, 0, r, 0, 0, 0, 0, 1);
+		memcpy(dst, column_major ? m.transpose().a : m.a, sizeof(float) * 16);
+	}
+}
+
+//*******************************************************************
+// floating origin: simulation positions stay in double, and only their offsets from the
+// origin (the camera) become float, so precision is highest where the viewer is
+inline vec3 relative_to(const dvec3& p, const dvec3& origin){ return vec3(float(p.x - origin.x), float(p.y - origin.y), float(p.z - origin.z)); }
+
+// eye-space normal matrix of a body: its model is Rz(angle)*S(radius), so the inverse transpose under a rigid
+// view is view3x3*Rz from the cosine and sine of the angle, without any matrix product or inverse
+inline void orbit_normal_matrix(const mat4& view, float c, float s, float* n, bool column_major)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		float v0 = view.a[i * 4], v1 = view.a[i * 4 + 1], v2 = view.a[i * 4 + 2];
+		float row[3] = { v0*c + v1*s, v1*c - v0*s, v2 };
+		for(int j = 0; j < 3; j++) n[column_major ? j * 3 + i : i * 3 + j] = row[j];
+	}
+}
+
+// double-precision orbits emitted relative to origin; rotation and scale are bounded, so only the translation needs doubles
+// centers, if given, offsets each body, e.g., by the propagated position of its parent
+// normals, if given, receives the eye-space normal matrix of each body under view, at the same stride and layout
+// the angles stay in double as well, since they grow with t; SSE2 takes two bodies at a time
+inline void compose_orbits(const dorbit_batch& b, double t, const dvec3& origin, float* out, size_t stride = sizeof(float) * 16, bool column_major = false, const dvec3* centers = nullptr,
+	const mat4* view = nullptr, float* normals = nullptr)
+{
+	size_t k = 0, n = b.size(); char* dst = (char*) out;
+#ifdef CGMATH_SSE
+	__m128d vt = _mm_set1_pd(t), ox = _mm_set1_pd(origin.x), oy = _mm_set1_pd(origin.y);
+	for(; k + 2 <= n; k += 2)
+	{
+		__m128d parent_angle = _mm_mul_pd(_mm_loadu_pd(&b.parent_revolve[k]), vt), orbit_angle = _mm_add_pd(parent_angle, _mm_mul_pd(_mm_loadu_pd(&b.revolve[k]), vt));
+		__m128d spin_angle = _mm_add_pd(orbit_angle, _mm_mul_pd(_mm_loadu_pd(&b.rotate[k]), vt));
+		__m128d parent_distance = _mm_loadu_pd(&b.parent_distance[k]), distance = _mm_loadu_pd(&b.distance[k]), radius = _mm_loadu_pd(&b.radius[k]);
+
+		__m128d sp, cp, so, co, ss, cs;
+		sse_sincos(parent_angle, sp, cp); sse_sincos(orbit_angle, so, co); sse_sincos(spin_angle, ss, cs);
+		__m128d px = _mm_add_pd(_mm_mul_pd(parent_distance, cp), _mm_mul_pd(distance, co));
+		__m128d py = _mm_add_pd(_mm_mul_pd(parent_distance, sp), _mm_mul_pd(distance, so)), pz = _mm_setzero_pd();
+		if(centers){ px = _mm_add_pd(px, _mm_setr_pd(centers[k].x, centers[k + 1].x)); py = _mm_add_pd(py, _mm_setr_pd(centers[k].y, centers[k + 1].y)); pz = _mm_setr_pd(centers[k].z, centers[k + 1].z); }
+
+		// float lanes: x, y, z relative to the origin, then radius*cos, radius*sin, and radius of the spin, then cos and sin
+		float f[8][4];
+		_mm_storeu_ps(f[0], _mm_cvtpd_ps(_mm_sub_pd(px, ox))); _mm_storeu_ps(f[1], _mm_cvtpd_ps(_mm_sub_pd(py, oy))); _mm_storeu_ps(f[2], _mm_cvtpd_ps(_mm_sub_pd(pz, _mm_set1_pd(origin.z))));
+		__m128 r = _mm_cvtpd_ps(radius), rc = _mm_mul_ps(r, _mm_cvtpd_ps(cs)), rs = _mm_mul_ps(r, _mm_cvtpd_ps(ss));
+		_mm_storeu_ps(f[3], rc); _mm_storeu_ps(f[4], rs); _mm_storeu_ps(f[5], r);
+		if(normals){ _mm_storeu_ps(f[6], _mm_cvtpd_ps(cs)); _mm_storeu_ps(f[7], _mm_cvtpd_ps(ss)); }
+		for(int j = 0; j < 2; j++, dst += stride)
+		{
+			if(normals) orbit_normal_matrix(*view, f[6][j], f[7][j], (float*) ((char*) normals + (k + j)*stride), column_major);
+			float* m = (float*) dst;
+			if(column_major)
+			{
+				_mm_storeu_ps(m, _mm_setr_ps(f[3][j], f[4][j], 0, 0)); _mm_storeu_ps(m + 4, _mm_setr_ps(-f[4][j], f[3][j], 0, 0));
+				_mm_storeu_ps(m + 8, _mm_setr_ps(0, 0, f[5][j], 0)); _mm_storeu_ps(m + 12, _mm_setr_ps(f[0][j], f[1][j], f[2][j], 1));
+			}
+			else
+			{
+				_mm_storeu_ps(m, _mm_setr_ps(f[3][j], -f[4][j], 0, f[0][j])); _mm_storeu_ps(m + 4, _mm_setr_ps(f[4][j], f[3][j], 0, f[1][j]));
+				_mm_storeu_ps(m + 8, _mm_setr_ps(0, 0, f[5][j], f[2][j])); _mm_storeu_ps(m + 12, _mm_setr_ps(0, 0, 0, 1));
+			}
+		}
+	}
+#endif
+	for(; k < n; k++, dst += stride)
+	{
+		double parent_angle = b.parent_revolve[k] * t, orbit_angle = parent_angle + b.revolve[k] * t, spin_angle = orbit_angle + b.rotate[k] * t;
+		dvec3 p(b.parent_distance[k] * cos(parent_angle) + b.distance[k] * cos(orbit_angle), b.parent_distance[k] * sin(parent_angle) + b.distance[k] * sin(orbit_angle), 0.0);
+		if(centers) p += centers[k];
+		vec3 tr = relative_to(p, origin);
+		float r = float(b.radius[k]), c = float(cos(spin_angle)), s = float(sin(spin_angle)), rc = r*c, rs = r*s;
+		mat4 m(rc, -rs, 0, tr.x, rs, rc, 0, tr.y, 0, 0, r, tr.z, 0, 0, 0, 1);
+		memcpy(dst, column_major ? m.transpose().a : m.a, sizeof(float) * 16);
+		if(normals) orbit_normal_matrix(*view, c, s, (float*) ((char*) normals + k*stride), column_major);
+	}
+}
 
 //*******************************************************************
 // scalar-vector operators
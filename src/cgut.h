@@ -5,9 +5,10 @@
 // minimum standard headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 
 // enforce not to use /MD or /MDd flag
-#ifdef _DLL
+#if defined(_MSC_VER) && defined(_DLL)
 	#error Use /MT (or /MTd for DEBUG) at Configuration -> C/C++ -> Code Generation -> Run-time Library
 #endif
 
@@ -16,11 +17,15 @@
 						// visit http://glad.dav1d.de/ to generate your own glad.h/glad.c of a different version
 						// suggested profile: OpenGL, gl Version 4.5, core profile
 #include "GL/glfw3.h"	// http://www.glfw.org
+#include "pack.h"		// memory-mapped asset pack
+#include "trace.h"		// per-thread event rings dumped as Chrome traces
 
 // explicitly link libraries
+#ifdef _MSC_VER
 #pragma comment( lib, "OpenGL32.lib" )		// link OpenGL32 library
 #pragma comment( lib, "glfw3.lib" )			// static version (currently, VC 2013)
 //#pragma comment( lib, "glfw3dll.lib" )	// dynamic version for other VC version
+#endif
 
 //*******************************************************************
 // common structures
@@ -28,6 +33,7 @@ struct mem_t
 {
 	char*	ptr = nullptr;
 	size_t	size = 0;
+	bool	mapped = false;	// ptr points into the asset pack and must not be freed
 };
 
 struct vertex // will be used for all the course examples
@@ -43,6 +49,7 @@ struct mesh
 	std::vector<uint>	index_list;
 	GLuint				vertex_buffer = 0;
 	GLuint				index_buffer = 0;
+	GLuint				vertex_array = 0;	// VAO recording the vertex layout and index buffer
 	GLuint				texture = 0;
 };
 
@@ -50,6 +57,10 @@ struct mesh
 // utility functions
 inline mem_t cg_read_binary( const char* file_path )
 {
+	// assets in the pack are returned in place; they are zero-terminated as well
+	const uchar* data; size_t size;
+	if(cg_assets().get( file_path, data, size )){ mem_t m; m.ptr = (char*) data; m.size = size; m.mapped = true; return m; }
+
 	FILE* fp = fopen( file_path, "rb" ); if(fp==nullptr){ printf( "[error] Unable to open %s\n", file_path ); return mem_t(); }
 	fseek( fp, 0L, SEEK_END);
 	mem_t m; m.size = ftell(fp);
@@ -61,22 +72,30 @@ inline mem_t cg_read_binary( const char* file_path )
 	return m;
 }
 
-inline char* cg_read_shader( const char* file_path )
+inline void cg_free_binary( mem_t& m )
+{
+	if(m.ptr&&!m.mapped) free(m.ptr);
+	m = mem_t();
+}
+
+inline mem_t cg_read_shader( const char* file_path )
 {
+#ifdef _WIN32
 	// get the full path of shader file
 	char module_file_path[_MAX_PATH]; GetModuleFileNameA( 0, module_file_path, _MAX_PATH );
 	char drive[_MAX_DRIVE], dir[_MAX_DIR], fname[_MAX_FNAME], ext[_MAX_EXT];
 	_splitpath_s( module_file_path, drive,_MAX_DRIVE,dir,_MAX_DIR,fname,_MAX_FNAME,ext,_MAX_EXT);
 	char shader_file_path[_MAX_PATH]; sprintf_s( shader_file_path, "%s%s%s", drive, dir, file_path );
+#endif
 	
 	// get the full path of a shader file
-	return cg_read_binary( file_path ).ptr;
+	return cg_read_binary( file_path );
 }
 
 inline bool cg_validate_shader( GLuint shaderID, const char* shaderName )
 {
 	const int MAX_LOG_LENGTH=4096;
-	static char msg[MAX_LOG_LENGTH] = {NULL};
+	static char msg[MAX_LOG_LENGTH] = {0};
 	GLint shaderInfoLogLength;
 
 	glGetShaderInfoLog( shaderID, MAX_LOG_LENGTH, &shaderInfoLogLength, msg );
@@ -93,7 +112,7 @@ inline bool cg_validate_shader( GLuint shaderID, const char* shaderName )
 inline bool cg_validate_program( GLuint programID, const char* programName )
 {
 	const int MAX_LOG_LENGTH=4096;
-	static char msg[MAX_LOG_LENGTH] = {NULL};
+	static char msg[MAX_LOG_LENGTH] = {0};
 	GLint programInfoLogLength;
 
 	glGetProgramInfoLog( programID, MAX_LOG_LENGTH, &programInfoLogLength, msg );
@@ -173,11 +192,22 @@ inline bool cg_init_extensions( GLFWwindow* window )
 	VALIDIDATE_GLAD_EXT( vertex_shader );			// functions related to vertex shaders
 	VALIDIDATE_GLAD_EXT( fragment_shader );			// functions related to fragment shaders
 	VALIDIDATE_GLAD_EXT( shader_objects );			// functions related to program and shaders
+	if(!GLAD_GL_VERSION_3_0&&!GLAD_GL_ARB_vertex_array_object){ printf( "init_extensions(): GLAD: GL_ARB_vertex_array_object not supported.\n" ); return false; }
+	if(!GLAD_GL_VERSION_3_3&&!GLAD_GL_ARB_instanced_arrays){ printf( "init_extensions(): GLAD: GL_ARB_instanced_arrays not supported.\n" ); return false; }
 #endif
 
 	return true;
 }
 
+// software rasterizers, e.g., Mesa llvmpipe on a headless machine, run shaders orders of magnitude slower than a GPU
+inline bool cg_software_renderer()
+{
+	const char* renderer = (const char*)glGetString(GL_RENDERER); if(!renderer) return false;
+	const char* names[] = { "llvmpipe", "softpipe", "SwiftShader", "Software", "GDI Generic" };
+	for(const char* n : names) if(strstr(renderer, n)) return true;
+	return false;
+}
+
 inline GLuint cg_create_program_from_string( const char* vertex_shader_source, const char* fragment_shader_source )
 {
 	// create a program before linking shaders
@@ -208,18 +238,170 @@ inline GLuint cg_create_program_from_string( const char* vertex_shader_source, c
 
 inline GLuint cg_create_program( const char* vert_path, const char* frag_path )
 {
-	const char* vertex_shader_source = cg_read_shader( vert_path ); if(vertex_shader_source==NULL) return 0;
-	const char* fragment_shader_source = cg_read_shader( frag_path ); if(fragment_shader_source==NULL) return 0;
+	mem_t vertex_shader_source = cg_read_shader( vert_path ); if(vertex_shader_source.ptr==NULL) return 0;
+	mem_t fragment_shader_source = cg_read_shader( frag_path ); if(fragment_shader_source.ptr==NULL){ cg_free_binary(vertex_shader_source); return 0; }
 	
 	// try to create a program
-	GLuint program = cg_create_program_from_string( vertex_shader_source, fragment_shader_source );
+	GLuint program = cg_create_program_from_string( vertex_shader_source.ptr, fragment_shader_source.ptr );
 
 	// deallocate string
-	free((void*)vertex_shader_source);
-	free((void*)fragment_shader_source);
+	cg_free_binary(vertex_shader_source);
+	cg_free_binary(fragment_shader_source);
+	return program;
+}
+
+// compute programs (GL 4.3) consist of a single compute shader
+inline GLuint cg_create_compute_program_from_string( const char* compute_shader_source )
+{
+	GLuint program = glCreateProgram();
+	GLuint compute_shader = glCreateShader( GL_COMPUTE_SHADER );
+	GLint compute_shader_length = strlen(compute_shader_source);
+	glShaderSource( compute_shader, 1, &compute_shader_source, &compute_shader_length );
+	glCompileShader( compute_shader );
+	if(!cg_validate_shader( compute_shader, "compute_shader" )){ printf( "Unable to compile compute shader\n" ); glDeleteProgram( program ); return 0; }
+
+	glAttachShader( program, compute_shader );
+	glLinkProgram( program );
+	glDeleteShader( compute_shader );	// flagged for deletion along with the program
+	if(!cg_validate_program( program, "compute program" )){ printf( "Unable to link compute program\n" ); return 0; }
+
+	return program;
+}
+
+inline GLuint cg_create_compute_program( const char* comp_path )
+{
+	mem_t compute_shader_source = cg_read_shader( comp_path ); if(compute_shader_source.ptr==NULL) return 0;
+	GLuint program = cg_create_compute_program_from_string( compute_shader_source.ptr );
+	cg_free_binary(compute_shader_source);
 	return program;
 }
 
+//*******************************************************************
+// program reflection: enumerate active uniforms/attributes once after linking
+struct program_var_t
+{
+	GLint	location = -1;	// -1 for inactive variables; glUniform*() silently ignores it
+	GLenum	type = 0;		// GL_FLOAT_VEC4, GL_FLOAT_MAT4, GL_SAMPLER_2D, ...
+	GLint	size = 0;		// number of array elements (1 for non-array variables)
+};
+
+struct program_info
+{
+	GLuint program = 0;
+	std::unordered_map<std::string,program_var_t> uniforms;
+	std::unordered_map<std::string,program_var_t> attribs;
+
+	// name lookups: use these only at init time to fill handle tables, never per draw
+	inline GLint uniform( const char* name, GLenum type=0 ) const { return find( uniforms, name, type, "uniform" ); }
+	inline GLint attrib( const char* name, GLenum type=0 ) const { return find( attribs, name, type, "attribute" ); }
+
+	inline GLint find( const std::unordered_map<std::string,program_var_t>& table, const char* name, GLenum type, const char* kind ) const
+	{
+		auto it = table.find(name); if(it==table.end()) return -1;	// inactive variable: not an error
+		if(type&&it->second.type!=type) printf( "[warning] %s %s: type 0x%04X, expected 0x%04X\n", kind, name, it->second.type, type );
+		return it->second.location;
+	}
+};
+
+inline program_info cg_reflect_program( GLuint program )
+{
+	program_info info; info.program = program; if(!program) return info;
+
+	// reserve a name buffer large enough for the longest uniform/attribute name
+	GLint count, ulen=0, alen=0;
+	glGetProgramiv( program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &ulen );
+	glGetProgramiv( program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &alen );
+	std::vector<char> name( max(ulen,alen)+1 );
+
+	glGetProgramiv( program, GL_ACTIVE_UNIFORMS, &count );
+	for( GLint k=0; k < count; k++ )
+	{
+		program_var_t v; GLsizei len=0;
+		glGetActiveUniform( program, GLuint(k), GLsizei(name.size()), &len, &v.size, &v.type, &name[0] );
+		v.location = glGetUniformLocation( program, &name[0] );
+		std::string s(&name[0],len); if(s.size()>3&&s.compare(s.size()-3,3,"[0]")==0) s.resize(s.size()-3); // arrays are reported as "name[0]"
+		info.uniforms[s] = v;
+	}
+
+	glGetProgramiv( program, GL_ACTIVE_ATTRIBUTES, &count );
+	for( GLint k=0; k < count; k++ )
+	{
+		program_var_t v; GLsizei len=0;
+		glGetActiveAttrib( program, GLuint(k), GLsizei(name.size()), &len, &v.size, &v.type, &name[0] );
+		v.location = glGetAttribLocation( program, &name[0] );
+		info.attribs[std::string(&name[0],len)] = v;
+	}
+
+	return info;
+}
+
+//*******************************************************************
+// record the layout of struct vertex into a VAO: bind it once per draw instead of re-specifying attributes
+inline GLuint cg_create_vertex_array( GLuint vertex_buffer, GLuint index_buffer, const GLint attrib_loc[3] ) // position, normal, texcoord
+{
+	size_t attrib_size[] = { sizeof(vertex().pos), sizeof(vertex().norm), sizeof(vertex().tex) };
+
+	GLuint vertex_array; glGenVertexArrays( 1, &vertex_array );
+	glBindVertexArray( vertex_array );
+	glBindBuffer( GL_ARRAY_BUFFER, vertex_buffer );
+	for( size_t k=0, kn=std::extent<decltype(attrib_size)>::value, byte_offset=0; k<kn; byte_offset+=attrib_size[k], k++ )
+	{
+		if(attrib_loc[k]<0) continue;	// inactive in the program
+		glEnableVertexAttribArray( attrib_loc[k] );
+		glVertexAttribPointer( attrib_loc[k], GLint(attrib_size[k]/sizeof(GLfloat)), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)byte_offset );
+	}
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, index_buffer );	// element array binding is part of the VAO state
+	glBindVertexArray( 0 );
+
+	return vertex_array;
+}
+
+//*******************************************************************
+// off-screen color and depth buffers, e.g., a float depth buffer that the default framebuffer cannot provide
+struct render_target
+{
+	GLuint	framebuffer = 0;
+	GLuint	color = 0;
+	GLuint	depth = 0;
+	ivec2	size = ivec2( 0, 0 );
+
+	// bind for drawing; the buffers are (re)allocated when the size changes
+	bool bind( ivec2 target_size, GLenum depth_format=GL_DEPTH_COMPONENT32F )
+	{
+		if(target_size!=size)
+		{
+			release();
+			glGenFramebuffers( 1, &framebuffer ); glGenRenderbuffers( 1, &color ); glGenRenderbuffers( 1, &depth );
+			glBindRenderbuffer( GL_RENDERBUFFER, color ); glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, target_size.x, target_size.y );
+			glBindRenderbuffer( GL_RENDERBUFFER, depth ); glRenderbufferStorage( GL_RENDERBUFFER, depth_format, target_size.x, target_size.y );
+			glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+			glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color );
+			glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth );
+			if(glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE){ printf( "[error] render target of %dx%d is incomplete\n", target_size.x, target_size.y ); release(); glBindFramebuffer( GL_FRAMEBUFFER, 0 ); return false; }
+			size = target_size;
+		}
+		glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+		return true;
+	}
+
+	// copy the color buffer to the default framebuffer and bind it again
+	void blit()
+	{
+		glBindFramebuffer( GL_READ_FRAMEBUFFER, framebuffer );
+		glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+		glBlitFramebuffer( 0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	}
+
+	void release()
+	{
+		if(framebuffer) glDeleteFramebuffers( 1, &framebuffer );
+		if(color) glDeleteRenderbuffers( 1, &color );
+		if(depth) glDeleteRenderbuffers( 1, &depth );
+		framebuffer = color = depth = 0; size = ivec2( 0, 0 );
+	}
+};
+
 //*******************************************************************
 inline mesh* cg_load_mesh( const char* vert_binary_path, const char* index_binary_path )
 {
@@ -238,8 +420,8 @@ inline mesh* cg_load_mesh( const char* vert_binary_path, const char* index_binar
 	memcpy( &new_mesh->index_list[0], i.ptr, i.size );
 
 	// release memory
-	if(v.ptr) free(v.ptr);
-	if(i.ptr) free(i.ptr);
+	cg_free_binary(v);
+	cg_free_binary(i);
 
 	// create a vertex buffer
 	glGenBuffers( 1, &new_mesh->vertex_buffer );
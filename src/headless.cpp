@@ -0,0 +1,110 @@
+//*******************************************************************
+// headless backend (CG_HEADLESS): the part of GLFW this app uses, implemented on an EGL pbuffer
+// of Mesa's surfaceless platform, so the renderer runs without a display, e.g., on llvmpipe in CI
+// or on render nodes; there is no input, and a window closes only by glfwSetWindowShouldClose()
+// the CMake build compiles this file in place of linking GLFW when CG_HEADLESS is on
+#include <stdio.h>
+#include <chrono>
+#define __GLU_H__		// as in cgut.h
+#include "GL/glad.h"
+#include "GL/glfw3.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+struct cg_headless_t
+{
+	EGLDisplay	display = EGL_NO_DISPLAY;
+	EGLSurface	surface = EGL_NO_SURFACE;
+	EGLContext	context = EGL_NO_CONTEXT;
+	int			width = 0, height = 0;
+	bool		should_close = false;
+	double		cursor[2];
+	std::chrono::steady_clock::time_point start;
+	GLFWvidmode	mode;
+};
+
+static cg_headless_t& cg_headless(){ static cg_headless_t h; return h; }
+
+extern "C" {
+
+int glfwInit(void)
+{
+	cg_headless_t& h = cg_headless(); h.start = std::chrono::steady_clock::now();
+
+	// the surfaceless platform needs no display server; fall back to the default display without it
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(get_platform_display) h.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if(h.display == EGL_NO_DISPLAY) h.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor; if(!eglInitialize(h.display, &major, &minor)){ printf("[error] eglInitialize() failed (0x%x)\n", eglGetError()); return GL_FALSE; }
+	if(!eglBindAPI(EGL_OPENGL_API)){ printf("[error] EGL has no desktop OpenGL\n"); return GL_FALSE; }
+	printf("> headless EGL %d.%d (%s)\n", major, minor, eglQueryString(h.display, EGL_VENDOR));
+	return GL_TRUE;
+}
+
+void glfwTerminate(void)
+{
+	cg_headless_t& h = cg_headless(); if(h.display == EGL_NO_DISPLAY) return;
+	eglTerminate(h.display); h.display = EGL_NO_DISPLAY;
+}
+
+void glfwWindowHint(int target, int hint){}
+
+// the window is a pbuffer with a compatibility context of GL 4.5, or whatever the driver offers by default
+GLFWwindow* glfwCreateWindow(int width, int height, const char* title, GLFWmonitor* monitor, GLFWwindow* share)
+{
+	cg_headless_t& h = cg_headless();
+	EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE };
+	EGLConfig config; EGLint count = 0;
+	if(!eglChooseConfig(h.display, config_attribs, &config, 1, &count) || count == 0){ printf("[error] no EGL config with a pbuffer\n"); return nullptr; }
+
+	EGLint surface_attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	if((h.surface = eglCreatePbufferSurface(h.display, config, surface_attribs)) == EGL_NO_SURFACE){ printf("[error] eglCreatePbufferSurface() failed (0x%x)\n", eglGetError()); return nullptr; }
+
+	EGLint context_attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5, EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE };
+	if((h.context = eglCreateContext(h.display, config, EGL_NO_CONTEXT, context_attribs)) == EGL_NO_CONTEXT) h.context = eglCreateContext(h.display, config, EGL_NO_CONTEXT, nullptr);
+	if(h.context == EGL_NO_CONTEXT){ printf("[error] eglCreateContext() failed (0x%x)\n", eglGetError()); eglDestroySurface(h.display, h.surface); return nullptr; }
+
+	h.width = width; h.height = height; h.should_close = false;
+	h.cursor[0] = width*0.5; h.cursor[1] = height*0.5;
+	return (GLFWwindow*) &h;
+}
+
+void glfwDestroyWindow(GLFWwindow* window)
+{
+	cg_headless_t& h = cg_headless();
+	eglMakeCurrent(h.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if(h.context != EGL_NO_CONTEXT) eglDestroyContext(h.display, h.context);
+	if(h.surface != EGL_NO_SURFACE) eglDestroySurface(h.display, h.surface);
+	h.context = EGL_NO_CONTEXT; h.surface = EGL_NO_SURFACE;
+}
+
+void glfwMakeContextCurrent(GLFWwindow* window){ cg_headless_t& h = cg_headless(); eglMakeCurrent(h.display, h.surface, h.surface, h.context); }
+GLFWglproc glfwGetProcAddress(const char* procname){ return (GLFWglproc) eglGetProcAddress(procname); }
+void glfwSwapBuffers(GLFWwindow* window){ cg_headless_t& h = cg_headless(); eglSwapBuffers(h.display, h.surface); }
+double glfwGetTime(void){ return std::chrono::duration<double>(std::chrono::steady_clock::now() - cg_headless().start).count(); }
+
+// a monitor as large as the window, so it is centered at the origin
+GLFWmonitor* glfwGetPrimaryMonitor(void){ return (GLFWmonitor*) &cg_headless(); }
+const GLFWvidmode* glfwGetVideoMode(GLFWmonitor* monitor)
+{
+	cg_headless_t& h = cg_headless();
+	h.mode.width = h.width; h.mode.height = h.height; h.mode.redBits = h.mode.greenBits = h.mode.blueBits = 8; h.mode.refreshRate = 0;
+	return &h.mode;
+}
+
+int glfwWindowShouldClose(GLFWwindow* window){ return cg_headless().should_close ? GL_TRUE : GL_FALSE; }
+void glfwSetWindowShouldClose(GLFWwindow* window, int value){ cg_headless().should_close = value != 0; }
+void glfwGetCursorPos(GLFWwindow* window, double* xpos, double* ypos){ if(xpos) *xpos = cg_headless().cursor[0]; if(ypos) *ypos = cg_headless().cursor[1]; }
+void glfwSetCursorPos(GLFWwindow* window, double xpos, double ypos){ cg_headless().cursor[0] = xpos; cg_headless().cursor[1] = ypos; }
+
+// no events: the rest only keeps the calls of a windowed run valid
+void glfwSetWindowPos(GLFWwindow* window, int xpos, int ypos){}
+void glfwShowWindow(GLFWwindow* window){}
+void glfwPollEvents(void){}
+void glfwSetInputMode(GLFWwindow* window, int mode, int value){}
+GLFWwindowsizefun glfwSetWindowSizeCallback(GLFWwindow* window, GLFWwindowsizefun cbfun){ return nullptr; }
+GLFWkeyfun glfwSetKeyCallback(GLFWwindow* window, GLFWkeyfun cbfun){ return nullptr; }
+GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow* window, GLFWmousebuttonfun cbfun){ return nullptr; }
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow* window, GLFWcursorposfun cbfun){ return nullptr; }
+
+} // extern "C"
@@ -0,0 +1,144 @@
+#pragma once
+#ifndef __KEPLER_H__
+#define __KEPLER_H__
+
+//*******************************************************************
+// Keplerian orbits: bodies are propagated from their orbital elements by solving
+// Kepler's equation M = E - e*sin(E) for the eccentric anomaly E, two bodies per SSE2 lane pair
+struct kepler_batch
+{
+	std::vector<double>	a, b, e;			// semi-major axis, semi-minor axis a*sqrt(1-e^2), and eccentricity
+	std::vector<double>	M0, n;				// mean anomaly at t=0 and mean motion, in radians
+	std::vector<double>	px, py, pz;			// unit vector to the periapsis in the reference frame
+	std::vector<double>	qx, qy, qz;			// unit vector 90 degrees ahead in the orbital plane
+
+	inline size_t size() const { return a.size(); }
+	inline void clear(){ a.clear(); b.clear(); e.clear(); M0.clear(); n.clear(); px.clear(); py.clear(); pz.clear(); qx.clear(); qy.clear(); qz.clear(); }
+
+	// angles in radians: inclination i, longitude of the ascending node, argument of periapsis
+	inline void push_back(double semi_major, double eccentricity, double i, double node, double peri, double mean_anomaly, double mean_motion)
+	{
+		a.push_back(semi_major); b.push_back(semi_major*sqrt(1.0 - eccentricity*eccentricity)); e.push_back(eccentricity);
+		M0.push_back(mean_anomaly); n.push_back(mean_motion);
+
+		// the perifocal frame rotated by Rz(node)*Rx(i)*Rz(peri)
+		double cn = cos(node), sn = sin(node), ci = cos(i), si = sin(i), cw = cos(peri), sw = sin(peri);
+		px.push_back(cn*cw - sn*sw*ci); py.push_back(sn*cw + cn*sw*ci); pz.push_back(sw*si);
+		qx.push_back(-cn*sw - sn*cw*ci); qy.push_back(-sn*sw + cn*cw*ci); qz.push_back(cw*si);
+	}
+};
+
+static const double	KEPLER_TOLERANCE = 1e-14;	// on the Newton step of E, in radians
+static const int	KEPLER_MAX_ITERATIONS = 16;
+
+// mean anomaly wrapped into [-pi,pi]; 2*pi in two parts keeps the reduction exact for long times
+inline double wrap_anomaly(double M){ double r = floor(M*(0.5 / PI) + 0.5); return (M - r*6.28318530717958623200) - r*2.44929359829470635445e-16; }
+
+// scalar Newton solver starting from Danby's guess E = M + 0.85*e*sign(M), which converges for all e < 1
+inline double solve_kepler(double M, double e)
+{
+	M = wrap_anomaly(M);
+	double E = M + (M < 0 ? -0.85 : 0.85)*e;
+	for(int k = 0; k < KEPLER_MAX_ITERATIONS; k++)
+	{
+		double d = (E - e*sin(E) - M) / (1.0 - e*cos(E)); E -= d;
+		if(fabs(d) < KEPLER_TOLERANCE) break;
+	}
+	return E;
+}
+
+//*******************************************************************
+// positions of bodies [begin,end) at time t
+inline void propagate_kepler(const kepler_batch& b, double t, dvec3* out, size_t begin, size_t end)
+{
+	size_t k = begin;
+#ifdef CGMATH_SSE
+	__m128d vt = _mm_set1_pd(t), one = _mm_set1_pd(1.0), sign = _mm_set1_pd(-0.0), tol = _mm_set1_pd(KEPLER_TOLERANCE);
+	for(; k + 2 <= end; k += 2)
+	{
+		// mean anomaly wrapped into [-pi,pi]
+		__m128d M = _mm_add_pd(_mm_loadu_pd(&b.M0[k]), _mm_mul_pd(_mm_loadu_pd(&b.n[k]), vt));
+		__m128d r = _mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(M, _mm_set1_pd(0.5 / PI))));
+		M = _mm_sub_pd(_mm_sub_pd(M, _mm_mul_pd(r, _mm_set1_pd(6.28318530717958623200))), _mm_mul_pd(r, _mm_set1_pd(2.44929359829470635445e-16)));
+
+		// Newton iterations until both lanes converge
+		__m128d e = _mm_loadu_pd(&b.e[k]), E = _mm_add_pd(M, _mm_mul_pd(e, _mm_or_pd(_mm_and_pd(M, sign), _mm_set1_pd(0.85)))), s, c;
+		for(int i = 0; i < KEPLER_MAX_ITERATIONS; i++)
+		{
+			sse_sincos(E, s, c);
+			__m128d d = _mm_div_pd(_mm_sub_pd(_mm_sub_pd(E, _mm_mul_pd(e, s)), M), _mm_sub_pd(one, _mm_mul_pd(e, c)));
+			E = _mm_sub_pd(E, d);
+			if(_mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(sign, d), tol)) == 3) break;
+		}
+		sse_sincos(E, s, c);
+
+		// position in the orbital plane, then in the reference frame
+		__m128d x = _mm_mul_pd(_mm_loadu_pd(&b.a[k]), _mm_sub_pd(c, e)), y = _mm_mul_pd(_mm_loadu_pd(&b.b[k]), s);
+		__m128d wx = _mm_add_pd(_mm_mul_pd(x, _mm_loadu_pd(&b.px[k])), _mm_mul_pd(y, _mm_loadu_pd(&b.qx[k])));
+		__m128d wy = _mm_add_pd(_mm_mul_pd(x, _mm_loadu_pd(&b.py[k])), _mm_mul_pd(y, _mm_loadu_pd(&b.qy[k])));
+		__m128d wz = _mm_add_pd(_mm_mul_pd(x, _mm_loadu_pd(&b.pz[k])), _mm_mul_pd(y, _mm_loadu_pd(&b.qz[k])));
+		_mm_storel_pd(&out[k].x, wx); _mm_storel_pd(&out[k].y, wy); _mm_storel_pd(&out[k].z, wz);
+		_mm_storeh_pd(&out[k + 1].x, wx); _mm_storeh_pd(&out[k + 1].y, wy); _mm_storeh_pd(&out[k + 1].z, wz);
+	}
+#endif
+	for(; k < end; k++)
+	{
+		double E = solve_kepler(b.M0[k] + b.n[k] * t, b.e[k]);
+		double x = b.a[k] * (cos(E) - b.e[k]), y = b.b[k] * sin(E);
+		out[k] = dvec3(x*b.px[k] + y*b.qx[k], x*b.py[k] + y*b.qy[k], x*b.pz[k] + y*b.qz[k]);
+	}
+}
+
+inline void propagate_kepler(const kepler_batch& b, double t, dvec3* out){ propagate_kepler(b, t, out, 0, b.size()); }
+
+// position and velocity of body k at time t, e.g., to seed an N-body simulation; velocity is per unit of t
+inline void kepler_state(const kepler_batch& b, size_t k, double t, dvec3& position, dvec3& velocity)
+{
+	double E = solve_kepler(b.M0[k] + b.n[k] * t, b.e[k]), c = cos(E), s = sin(E), dE = b.n[k] / (1.0 - b.e[k] * c);
+	double x = b.a[k] * (c - b.e[k]), y = b.b[k] * s, vx = -b.a[k] * s*dE, vy = b.b[k] * c*dE;
+	position = dvec3(x*b.px[k] + y*b.qx[k], x*b.py[k] + y*b.qy[k], x*b.pz[k] + y*b.qz[k]);
+	velocity = dvec3(vx*b.px[k] + vy*b.qx[k], vx*b.py[k] + vy*b.qy[k], vx*b.pz[k] + vy*b.qz[k]);
+}
+
+// split the batch over threads in even-sized chunks; worth it only for large batches
+inline void propagate_kepler(const kepler_batch& b, double t, dvec3* out, int thread_count)
+{
+	size_t n = b.size(), chunk = ((n + thread_count - 1) / thread_count + 1) & ~size_t(1);
+	std::vector<std::thread> threads;
+	for(size_t begin = chunk; begin < n; begin += chunk) threads.push_back(std::thread([&b, t, out, begin, chunk, n](){ propagate_kepler(b, t, out, begin, min(begin + chunk, n)); }));
+	propagate_kepler(b, t, out, 0, min(chunk, n));
+	for(auto& th : threads) th.join();
+}
+
+//*******************************************************************
+// throughput of the propagator on random elements, checked against the scalar solver
+inline void kepler_benchmark(size_t count, int repeat = 20)
+{
+	kepler_batch b; srand(1);
+	auto uniform = [](double lo, double hi){ return lo + (hi - lo)*rand() / double(RAND_MAX); };
+	for(size_t k = 0; k < count; k++) b.push_back(uniform(0.3, 40.0), uniform(0.0, 0.95), uniform(0.0, PI), uniform(0.0, 2 * PI), uniform(0.0, 2 * PI), uniform(0.0, 2 * PI), uniform(0.01, 2.0));
+	std::vector<dvec3> out(count);
+
+	typedef std::chrono::high_resolution_clock clock;
+	int thread_count = max(1, int(std::thread::hardware_concurrency()));
+	double rate[2] = { 0, 0 };
+	for(int pass = 0; pass < 2; pass++)
+	{
+		int threads = pass == 0 ? 1 : thread_count;
+		auto t0 = clock::now();
+		for(int r = 0; r < repeat; r++) propagate_kepler(b, 1000.0 + r, &out[0], threads);
+		rate[pass] = count*double(repeat) / std::chrono::duration<double>(clock::now() - t0).count();
+	}
+
+	// the last pass ran at t = 1000+repeat-1; compare against the scalar path
+	double t = 1000.0 + repeat - 1, err = 0;
+	for(size_t k = 0; k < count; k++)
+	{
+		double E = solve_kepler(b.M0[k] + b.n[k] * t, b.e[k]), x = b.a[k] * (cos(E) - b.e[k]), y = b.b[k] * sin(E);
+		dvec3 d = out[k] - dvec3(x*b.px[k] + y*b.qx[k], x*b.py[k] + y*b.qy[k], x*b.pz[k] + y*b.qz[k]);
+		err = max(err, d.length() / b.a[k]);
+	}
+	printf("> kepler: %d bodies, 1 thread: %.1f M bodies/s, %d threads: %.1f M bodies/s (%.2fx), max relative error %.1e\n", int(count), rate[0] / 1e6, thread_count, rate[1] / 1e6, rate[1] / rate[0], err);
+}
+
+#endif // __KEPLER_H__
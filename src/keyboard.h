@@ -41,9 +41,10 @@ struct keypress
 		return angle;
 	}
 
-	vec3 calculateDifference(vec3 eye, vec3 at)
+	// motion over dt seconds: 0.6 units per second, i.e., 0.01 per frame at 60 fps
+	vec3 calculateDifference(vec3 eye, vec3 at, float dt)
 	{
-		float scale = 0.01f;
+		float scale = 0.6f*dt;
 		float angle = getFacingAngle();
 		float rad = angle * (PI / 180);
 		vec3 n, f;
@@ -23,20 +23,40 @@ struct texmaterial_t : public material_t
 	GLuint cubemapTexture;
 };
 
-light_t		light;
-material_t	material;
+struct light_uniforms
+{
+	GLint light_position = -1, Ia = -1, Id = -1, Is = -1;	// light
+	GLint Ka = -1, Kd = -1, Ks = -1, shininess = -1;			// material
+};
+
+light_t			light;
+material_t		material;
+light_uniforms	light_loc;
+
+void init_light(const program_info& info)
+{
+	// resolve light/material uniform locations once after linking
+	light_loc.light_position = info.uniform("light_position", GL_FLOAT_VEC4);
+	light_loc.Ia = info.uniform("Ia", GL_FLOAT_VEC4);
+	light_loc.Id = info.uniform("Id", GL_FLOAT_VEC4);
+	light_loc.Is = info.uniform("Is", GL_FLOAT_VEC4);
+	light_loc.Ka = info.uniform("Ka", GL_FLOAT_VEC4);
+	light_loc.Kd = info.uniform("Kd", GL_FLOAT_VEC4);
+	light_loc.Ks = info.uniform("Ks", GL_FLOAT_VEC4);
+	light_loc.shininess = info.uniform("shininess", GL_FLOAT);
+}
 
-void update_light(GLuint program)
+void update_light()
 {
 	// setup light properties
-	glUniform4fv(glGetUniformLocation(program, "light_position"), 1, light.position);
-	glUniform4fv(glGetUniformLocation(program, "Ia"), 1, light.ambient);
-	glUniform4fv(glGetUniformLocation(program, "Id"), 1, light.diffuse);
-	glUniform4fv(glGetUniformLocation(program, "Is"), 1, light.specular);
+	glUniform4fv(light_loc.light_position, 1, light.position);
+	glUniform4fv(light_loc.Ia, 1, light.ambient);
+	glUniform4fv(light_loc.Id, 1, light.diffuse);
+	glUniform4fv(light_loc.Is, 1, light.specular);
 
 	// setup material properties
-	glUniform4fv(glGetUniformLocation(program, "Ka"), 1, material.ambient);
-	glUniform4fv(glGetUniformLocation(program, "Kd"), 1, material.diffuse);
-	glUniform4fv(glGetUniformLocation(program, "Ks"), 1, material.specular);
-	glUniform1f(glGetUniformLocation(program, "shininess"), material.shininess);
+	glUniform4fv(light_loc.Ka, 1, material.ambient);
+	glUniform4fv(light_loc.Kd, 1, material.diffuse);
+	glUniform4fv(light_loc.Ks, 1, material.specular);
+	glUniform1f(light_loc.shininess, material.shininess);
 }
\ No newline at end of file
@@ -3,20 +3,33 @@
 
 #include "keyboard.h"
 #include "mouse.h"
+#include "simclock.h"
+#include "profiler.h"
+#include "bench.h"
 
 #include "light.h"
 #include "planets.h"
+#include "kepler.h"
+#include "synthetic.h"
+#include "nbody.h"
+#include "nbody_gpu.h"
 
 //*******************************************************************
 // include stb_image with the implementation preprocessor definition
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "texcache.h"
+#include "texture.h"
+
 //*******************************************************************
 // global constants
 static const char*	window_name = "T1 - Team 4";
 static const char*	vert_shader_path = "../bin/shaders/circ.vert";
 static const char*	frag_shader_path = "../bin/shaders/circ.frag";
+static const char*	nbody_comp_path = "../bin/shaders/nbody.comp";
+static const char*	asset_pack_path = "../bin/assets.pack";	// built with --build-pack and read with --pack; loose files are used otherwise
+static const char*	trace_path = "trace.json";				// Chrome trace written by 'c'
 
 //*******************************************************************
 // window objects
@@ -26,10 +39,48 @@ ivec2		window_size = ivec2(1024, 576);	// initial window size
 //*******************************************************************
 // OpenGL objects
 GLuint	program = 0;					// ID holder for GPU program
-GLuint	sphere_vertex_buffer = 0;		// ID holder for sphere vertex buffer
-GLuint	sphere_index_buffer = 0;		// ID holder for sphere index buffer
-GLuint	ring_vertex_buffer = 0;			// ID holder for ring vertex buffer
-GLuint	ring_index_buffer = 0;			// ID holder for ring index buffer
+mesh	sphere_mesh;					// sphere geometry shared by planets and dwarfs
+mesh	ring_mesh;						// ring geometry
+GLuint	sphere_instance_buffer = 0;		// per-instance data of planets and dwarfs
+GLuint	ring_instance_buffer = 0;		// per-instance data of rings
+GLuint	particle_buffer = 0;			// positions of the N-body particles
+GLuint	particle_vertex_array = 0;
+GLuint	gpu_sphere_vertex_array = 0;	// sphere mesh with instances written by the GPU N-body
+GLuint	gpu_point_vertex_array = 0;		// far bodies of the GPU N-body
+
+//*******************************************************************
+// uniform/attribute locations: resolved once in user_init() via program reflection
+struct
+{
+	GLint	view_matrix = -1;
+	GLint	projection_matrix = -1;
+	GLint	blendEnabled = -1;
+	GLint	log_depth = -1;
+	GLint	TEX = -1;
+} uloc;
+GLint	aloc[3] = { -1, -1, -1 };		// position, normal, texcoord
+GLint	iloc[3] = { -1, -1, -1 };		// instance_model, instance_info, instance_normal
+
+//*******************************************************************
+// per-instance vertex attributes (divisor 1)
+struct instance_t
+{
+	mat4	model_matrix;	// stored transposed (column-major) for attribute upload
+	vec4	info;			// x: texture layer, y: shaded (1) or emissive (0)
+	mat3	normal_matrix;	// eye-space normal matrix, stored transposed as well
+};
+
+std::vector<instance_t>	sphere_instances;	// planets followed by dwarfs
+std::vector<instance_t>	ring_instances;
+dorbit_batch			sphere_orbits;		// SoA spin and moon orbits of sphere_instances in double, composed in one pass per frame
+dorbit_batch			ring_orbits;
+kepler_batch			planet_orbits;		// Keplerian orbits of the planets, propagated once per frame
+std::vector<dvec3>		planet_positions;
+std::vector<uint>		sphere_parents;		// planet whose position centers each instance
+std::vector<uint>		ring_parents;
+std::vector<dvec3>		sphere_centers;		// planet_positions gathered per instance
+std::vector<dvec3>		ring_centers;
+std::vector<vec3>		particle_positions;	// camera-relative positions of the N-body particles
 
 //*******************************************************************
 // global variables
@@ -37,173 +88,407 @@ float	initAngle = 260.0f;
 int		frame = 0;				// index of rendering frames
 float	radius = 1.0f;
 bool	bWireframe = false;
+bool	bRealScale = false;		// astronomical sizes and distances instead of the toy solar system
+bool	bNBody = false;			// planets and the asteroid belt under mutual gravity instead of Keplerian orbits
+bool	bGPUNBody = false;		// the N-body simulation runs in a compute shader
+uint	draw_calls = 0;			// issued in the current frame, for --bench
+double	scene_radius = 0;		// largest distance of a planet from the sun at the toy scale
+
+//*******************************************************************
+// depth modes: the standard mapping wastes its precision near the camera, so astronomical ranges
+// need reversed-Z in a float depth buffer, or logarithmic depth where clip control is missing
+enum depth_mode_t { DEPTH_STANDARD, DEPTH_REVERSED, DEPTH_LOG, DEPTH_MODE_COUNT };
+static const char* depth_mode_name[] = { "standard", "reversed-Z", "logarithmic" };
+depth_mode_t	depth_mode = DEPTH_STANDARD;
+
+// profiled phases of a frame, in their order
+enum profile_phase_t { PROFILE_SIMULATE, PROFILE_UPDATE, PROFILE_SPHERES, PROFILE_PARTICLES, PROFILE_RINGS, PROFILE_GPU_NBODY, PROFILE_SWAP, PROFILE_PHASE_COUNT };
+static const char* profile_phase_name[] = { "simulate", "update", "spheres", "particles", "rings", "gpu_nbody", "swap" };
+render_target	depth_target;		// color and 32-bit float depth for reversed-Z
 double	oldTime;
 float	lastAngle;
 
-GLuint	texture_planet[10];
-GLuint	texture_ring[2];
+GLuint	texture_planet = 0;		// array texture of planet surfaces (layer 9: moon for all dwarfs)
+GLuint	texture_ring = 0;		// array texture of rings
 
 //*******************************************************************
 // objects
+texture_streamer	streamer;		// background texture loader
 mesh*		pMesh = nullptr;
 camera		cam;
 keypress	pkey;
+nbody_system	nbody;				// the sun and the planets first, then the belt particles
+gpu_nbody		gpu;				// the same bodies in GPU buffers when bGPUNBody is set
+sim_clock		sim;				// scene time: orbits are evaluated and bodies stepped on this clock
+frame_bench		bench;				// --bench: frame-driven time and camera, and the recorded frame times
+profiler		prof;				// per-phase CPU and GPU times, toggled with 't' or --profile
+synthetic_scene	synthetic;			// generated in place of the solar system at the toy scale, if it has planets
+
+static const double	time_scale = 0.5;	// scene time per second at normal speed
+
+static const size_t	nbody_major_count = 9;			// the sun and the planets ahead of the belt
+size_t				nbody_belt_count = 20000;
+size_t				gpu_nbody_belt_count = 0;		// all pairs on the GPU; zero picks a count for the renderer in user_init()
+static const double	nbody_dt = 0.002;	// years per step
+
 
 //*******************************************************************
-// holder of vertices and indices
-std::vector<vertex> sphere_vertex_list;
-std::vector<uint> sphere_index_list;
-std::vector<vertex> ring_vertex_list;
-std::vector<uint> ring_index_list;
+// N-body mode: seeded from the J2000 elements and planet masses, then integrated with the fixed steps
+// of the simulation clock, where a year lasts 2*pi/revolve of the earth
+inline double nbody_years(double t){ return t*planets[3].revolve / (2 * PI); }
+
+void seed_nbody(double t, size_t belt_count)
+{
+	double years = nbody_years(t), rad = PI / 180.0;
+	nbody.clear(); nbody.add(dvec3(0.0), dvec3(0.0), planet_scales[0].mass);
+	kepler_batch b; std::vector<double> m;
+	for(uint k = 1; k < 9; k++)
+	{
+		const planet_scale& p = planet_scales[k];
+		b.push_back(p.a, p.e, p.i*rad, p.node*rad, p.peri*rad, p.M0*rad, kepler_mean_motion(p.a, planet_scales[0].mass + p.mass)); m.push_back(p.mass);
+	}
+	add_kepler_bodies(nbody, 0, b, &m[0], years);
+	add_belt(nbody, 0, belt_count, 2.1, 3.3, 0.15, 0.17, 1.2e-9);	// the main belt, about 2.4e21 kg
+	nbody.recenter();
+	nbody.compute_accelerations();
+	nbody.previous = nbody.position;
+	nbody.time = years;
+}
+
+// one fixed step of the simulation clock; dt is negative while time runs backward
+void step_simulation(double dt)
+{
+	if(!bNBody) return;	// Keplerian orbits are evaluated at the render time directly
+	if(bGPUNBody) gpu.step(float(nbody_years(dt)));
+	else nbody.step(nbody_years(dt));
+}
+
+// planet positions between the last two steps
+void interpolate_nbody(double alpha)
+{
+	double s = KM_PER_AU / KM_PER_UNIT;
+	for(uint k = 0; k < 9; k++) planet_positions[k] = nbody.interpolate(k, alpha) * s;
+}
+
+// particles are points through the same program; attributes without arrays take the constant values set here
+void set_particle_attributes()
+{
+	for(int c = 0; c < 4; c++) glVertexAttrib4f(iloc[0] + c, float(c == 0), float(c == 1), float(c == 2), float(c == 3));	// identity model matrix
+	glVertexAttrib4f(iloc[1], 9.0f, 0.0f, 0.0f, 0.0f);	// moon texture, emissive
+	for(int c = 0; c < 3; c++) glVertexAttrib3f(iloc[2] + c, float(c == 0), float(c == 1), float(c == 2));
+	glVertexAttrib3f(aloc[1], 0.0f, 0.0f, 1.0f);
+	glVertexAttrib2f(aloc[2], 0.5f, 0.5f);
+}
+
+void draw_particles()
+{
+	profile_scope scope(prof, PROFILE_PARTICLES);
+	size_t n = nbody.size() - 9; if(n == 0) return;
+	particle_positions.resize(n);
+	double s = KM_PER_AU / KM_PER_UNIT;
+	double alpha = sim.alpha();
+	for(size_t k = 0; k < n; k++) particle_positions[k] = relative_to(nbody.interpolate(k + 9, alpha) * s, cam.origin);
+
+	glBindBuffer(GL_ARRAY_BUFFER, particle_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*n, &particle_positions[0], GL_STREAM_DRAW);
+	glBindVertexArray(particle_vertex_array);
+	set_particle_attributes();
+	glDrawArrays(GL_POINTS, 0, GLsizei(n)); draw_calls++;
+}
+
+// GPU N-body: the compute shader sorts the bodies into sphere instances and points for this view,
+// and both draws take their counts from the command buffer it wrote
+void draw_gpu_nbody()
+{
+	profile_scope scope(prof, PROFILE_GPU_NBODY);
+	float near_ratio = GPU_NBODY_NEAR_PIXELS * 2.0f * tan(cam.fovy*0.5f) / window_size.y;
+	gpu.emit(cam.view_matrix, cam.origin, float(KM_PER_AU / KM_PER_UNIT), near_ratio, sim.alpha(), uint(sphere_mesh.index_list.size()));
+
+	glUseProgram(program);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpu.commands);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture_planet);
+	glBindVertexArray(gpu_sphere_vertex_array);
+	glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(gpu_point_vertex_array);
+	set_particle_attributes();
+	glDrawArraysIndirect(GL_POINTS, gpu_nbody::point_command());
+	draw_calls += 2;
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
 
 //*******************************************************************
+void resolve_locations()
+{
+	program_info info = cg_reflect_program(program);
+	uloc.view_matrix		= info.uniform("view_matrix", GL_FLOAT_MAT4);
+	uloc.projection_matrix	= info.uniform("projection_matrix", GL_FLOAT_MAT4);
+	uloc.blendEnabled		= info.uniform("blendEnabled", GL_BOOL);
+	uloc.log_depth			= info.uniform("log_depth", GL_FLOAT);
+	uloc.TEX				= info.uniform("TEX", GL_SAMPLER_2D_ARRAY);
+	aloc[0] = info.attrib("position", GL_FLOAT_VEC3);
+	aloc[1] = info.attrib("normal", GL_FLOAT_VEC3);
+	aloc[2] = info.attrib("texcoord", GL_FLOAT_VEC2);
+	iloc[0] = info.attrib("instance_model", GL_FLOAT_MAT4);
+	iloc[1] = info.attrib("instance_info", GL_FLOAT_VEC4);
+	iloc[2] = info.attrib("instance_normal", GL_FLOAT_MAT3);
+	init_light(info);
+}
+
+// any write of gl_FragDepth turns off early depth tests, so circ.frag writes it only under LOG_DEPTH;
+// the fragment shader is swapped and the program relinked when logarithmic depth is turned on or off
+bool relink_program(bool log_depth)
+{
+	mem_t source = cg_read_shader(frag_shader_path); if(!source.ptr) return false;
+	const char* eol = strchr(source.ptr, '\n'); if(!eol){ cg_free_binary(source); return false; }	// the define goes after #version
+	const char* strings[] = { source.ptr, log_depth ? "#define LOG_DEPTH\n" : "", eol + 1 };
+	GLint lengths[] = { GLint(eol + 1 - source.ptr), -1, -1 };
+	GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(shader, 3, strings, lengths);
+	glCompileShader(shader);
+	cg_free_binary(source);
+	if(!cg_validate_shader(shader, "fragment_shader")){ glDeleteShader(shader); return false; }
+
+	// replace the fragment shader; the attributes keep their locations, which the vertex arrays refer to
+	GLuint attached[2]; GLsizei count = 0; glGetAttachedShaders(program, 2, &count, attached);
+	for(GLsizei k = 0; k < count; k++){ GLint type; glGetShaderiv(attached[k], GL_SHADER_TYPE, &type); if(type == GL_FRAGMENT_SHADER){ glDetachShader(program, attached[k]); glDeleteShader(attached[k]); } }
+	glAttachShader(program, shader);
+	static const char* attrib_name[] = { "position", "normal", "texcoord", "instance_model", "instance_info", "instance_normal" };
+	for(int k = 0; k < 6; k++){ GLint loc = k < 3 ? aloc[k] : iloc[k - 3]; if(loc >= 0) glBindAttribLocation(program, loc, attrib_name[k]); }
+	glLinkProgram(program);
+	if(!cg_validate_program(program, "program")) return false;
+
+	// uniform locations may move and their values are reset by linking; the others are set per frame
+	resolve_locations();
+	glUseProgram(program);
+	glUniform1i(uloc.TEX, 0); // GL_TEXTURE0
+	return true;
+}
+
+void set_depth_mode(depth_mode_t mode)
+{
+	if(mode == DEPTH_REVERSED && !GLAD_GL_VERSION_4_5 && !GLAD_GL_ARB_clip_control){ printf("[warning] reversed-Z needs clip control; using logarithmic depth\n"); mode = DEPTH_LOG; }
+	if(mode != DEPTH_REVERSED && depth_target.framebuffer){ glBindFramebuffer(GL_FRAMEBUFFER, 0); depth_target.release(); }
+	if((mode == DEPTH_LOG) != (depth_mode == DEPTH_LOG) && !relink_program(mode == DEPTH_LOG)) printf("[error] failed to relink the program for %s depth\n", depth_mode_name[mode]);
+	depth_mode = mode;
+
+	// reversed-Z clears to zero and keeps the nearer fragment with the greater depth
+	bool reversed = mode == DEPTH_REVERSED;
+	if(GLAD_GL_VERSION_4_5 || GLAD_GL_ARB_clip_control) glClipControl(GL_LOWER_LEFT, reversed ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+	glClearDepth(reversed ? 0.0 : 1.0);
+	glDepthFunc(reversed ? GL_GREATER : GL_LESS);
+}
+
 void update()
 {
+	// fixed steps of the simulation for the time since the previous frame
+	prof.begin(PROFILE_SIMULATE);
+	for(int k = 0, n = sim.advance(bench.active() ? bench.time() : glfwGetTime()); k < n; k++) step_simulation(sim.tick());
+	prof.end(PROFILE_SIMULATE);
+	prof.begin(PROFILE_UPDATE);
+
+	// swap in textures finished in the background
+	if(streamer.pending())
+	{
+		streamer.update();
+		if(!streamer.pending())
+		{
+			// streaming report: wall-clock time against the sum of per-image decode times
+			double serial_time = 0; int cached = 0; for(auto& j : streamer.jobs){ serial_time += j.image.decode_time; cached += j.image.cached ? 1 : 0; }
+			printf("> streamed %d textures (%d from cache) in %.1f ms (serial decode: %.1f ms, %.2fx), peak image memory %.1f MB\n", int(streamer.jobs.size()), cached, streamer.wall_time*1000.0, serial_time*1000.0, serial_time / streamer.wall_time, streamer.memory.peak / 1048576.0);
+		}
+	}
+
+	// the benchmark flies its scripted path around the sun, beyond the outermost planet at the toy scale
+	if(bench.active()) bench_flight(cam, bench.progress(), bRealScale ? 3.0*KM_PER_AU / KM_PER_UNIT : 1.2*scene_radius);
+
 	// move camera as WASD moving
-	if (pkey.isKeyPressed())
+	else if (pkey.isKeyPressed())
 	{
-		vec3 diff = pkey.calculateDifference(cam.eye, cam.at);
+		vec3 diff = pkey.calculateDifference(cam.eye, cam.at, float(sim.frame_time))*cam.speed;	// real time, so it works while paused
 		cam.eye += diff;
 		cam.at += diff;
 	}
+	cam.recenter(1024.0f);
 
 	// update view matrix
 	cam.view_matrix = mat4::lookAt(cam.eye, cam.at, cam.up);
 
 	// update projection matrix
 	cam.aspect_ratio = window_size.x / float(window_size.y);
-	cam.projection_matrix = mat4::perspective(cam.fovy, cam.aspect_ratio, cam.dNear, cam.dFar);
+	cam.projection_matrix = depth_mode == DEPTH_REVERSED ? mat4::perspectiveReversed(cam.fovy, cam.aspect_ratio, cam.dNear) : mat4::perspective(cam.fovy, cam.aspect_ratio, cam.dNear, cam.dFar);
 
 	// update uniform variables in vertex/fragment shaders
-	glUniformMatrix4fv(glGetUniformLocation(program, "view_matrix"), 1, GL_TRUE, cam.view_matrix);
-	glUniformMatrix4fv(glGetUniformLocation(program, "projection_matrix"), 1, GL_TRUE, cam.projection_matrix);
-
-	// enable texture manager
-	glUniform1i(glGetUniformLocation(program, "TEX1"), 0); // GL_TEXTURE0
-
-	// update shading variables
-	update_light(program);
+	glUniformMatrix4fv(uloc.view_matrix, 1, GL_TRUE, cam.view_matrix);
+	glUniformMatrix4fv(uloc.projection_matrix, 1, GL_TRUE, cam.projection_matrix);
+	glUniform1f(uloc.log_depth, depth_mode == DEPTH_LOG ? 2.0f / log2(cam.dFar + 1.0f) : 0.0f);
+
+	// update shading variables: the light sits at the sun, which is at the world origin
+	light.position = vec4(relative_to(dvec3(0.0), cam.origin), 1.0f);
+	update_light();
+	prof.end(PROFILE_UPDATE);
 }
 
 void render()
 {
+	// reversed-Z renders off-screen into a float depth buffer; fall back to logarithmic depth without one
+	if(depth_mode == DEPTH_REVERSED && !depth_target.bind(window_size)) set_depth_mode(DEPTH_LOG);
+
 	// clear screen (with background color) and clear depth buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	draw_calls = 0;
 
 	// notify GL that we use our own program
 	glUseProgram(program);
 
-	// variables
-	const char*	vertex_attrib[] = {"position", "normal", "texcoord"};
-	size_t		attrib_size[] = {sizeof(vertex().pos), sizeof(vertex().norm), sizeof(vertex().tex)};
-
 	//------------------------------
 	// draw spheres & dwarfs
 
-	// bind vertex attributes to your shader program
-	for(size_t k = 0, kn = std::extent<decltype(vertex_attrib)>::value, byte_offset = 0; k<kn; k++, byte_offset += attrib_size[k - 1])
+	// the GPU simulation draws the sun, the planets, and the belt straight from its buffers;
+	// moons and rings would need the planet positions back on the CPU, so they are left out there
+	double t = sim.render_time();
+	if(bGPUNBody) draw_gpu_nbody();
+	else
 	{
-		GLuint loc = glGetAttribLocation(program, vertex_attrib[k]); if(loc >= kn) continue;
-		glEnableVertexAttribArray(loc);
-		glBindBuffer(GL_ARRAY_BUFFER, sphere_vertex_buffer);
-		glVertexAttribPointer(loc, attrib_size[k] / sizeof(GLfloat), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)byte_offset);
+		// planet positions from their orbital elements, then the model matrices of planets and dwarfs around
+		// them in one batched pass, written transposed into the instances and relative to the camera origin,
+		// along with their eye-space normal matrices, which the vertex shader no longer forms per vertex
+		prof.begin(PROFILE_SPHERES);
+		if(bNBody) interpolate_nbody(sim.alpha());
+		else propagate_kepler(planet_orbits, t, &planet_positions[0]);
+		for(size_t k = 0; k < sphere_parents.size(); k++) sphere_centers[k] = planet_positions[sphere_parents[k]];
+		for(size_t k = 0; k < ring_parents.size(); k++) ring_centers[k] = planet_positions[ring_parents[k]];
+		compose_orbits(sphere_orbits, t, cam.origin, sphere_instances[0].model_matrix, sizeof(instance_t), true, &sphere_centers[0], &cam.view_matrix, sphere_instances[0].normal_matrix);
+
+		// upload instances (orphaning the previous storage) and draw all spheres at once
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture_planet);
+		glBindBuffer(GL_ARRAY_BUFFER, sphere_instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(instance_t)*sphere_instances.size(), &sphere_instances[0], GL_STREAM_DRAW);
+		glBindVertexArray(sphere_mesh.vertex_array);
+		glDrawElementsInstanced(GL_TRIANGLES, sphere_mesh.index_list.size(), GL_UNSIGNED_INT, nullptr, sphere_instances.size()); draw_calls++;
+		prof.end(PROFILE_SPHERES);
+
+		// belt particles of the N-body mode
+		if(bNBody) draw_particles();
+
+		//------------------------------
+		// draw rings (a small synthetic scene may have none)
+		if(!ring_instances.empty())
+		{
+			profile_scope scope(prof, PROFILE_RINGS);
+
+			// enable alpha blending
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glUniform1i(uloc.blendEnabled, 1);
+
+			// model and normal matrices of rings
+			compose_orbits(ring_orbits, t, cam.origin, ring_instances[0].model_matrix, sizeof(instance_t), true, &ring_centers[0], &cam.view_matrix, ring_instances[0].normal_matrix);
+
+			// upload ring instances and switch geometry and texture with a single bind each
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture_ring);
+			glBindBuffer(GL_ARRAY_BUFFER, ring_instance_buffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(instance_t)*ring_instances.size(), &ring_instances[0], GL_STREAM_DRAW);
+			glBindVertexArray(ring_mesh.vertex_array);
+			glDrawElementsInstanced(GL_TRIANGLES, ring_mesh.index_list.size(), GL_UNSIGNED_INT, nullptr, ring_instances.size()); draw_calls++;
+			glBindVertexArray(0);
+
+			// disable alpha blending
+			glDisable(GL_BLEND);
+			glUniform1i(uloc.blendEnabled, 0);
+		}
 	}
 
-	// render vertices: trigger shader programs to process vertex data
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere_index_buffer);
+	//------------------------------
+	// swap front and back buffers, and display to screen
+	prof.begin(PROFILE_SWAP);
+	if(depth_mode == DEPTH_REVERSED) depth_target.blit();
+	glfwSwapBuffers(window);
+	prof.end(PROFILE_SWAP);
+}
 
-	// draw planets
-	mat4 model_matrix;
-	float t = float(glfwGetTime()) * 0.5f;
+void update_and_render()
+{
+	update();
+	render();
+}
+
+void reshape(GLFWwindow* window, int width, int height)
+{
+	window_size = ivec2(width, height);
+	glViewport(0, 0, width, height);
+	update_and_render();
+}
+
+//*******************************************************************
+// radius and distance of planet k in scene units; the real scale keeps the toy angular speeds
+inline double planet_radius(uint k){ return bRealScale ? planet_scales[k].radius_km / KM_PER_UNIT : planets[k].radius; }
+inline double planet_distance(uint k){ return bRealScale ? planet_scales[k].a*KM_PER_AU / KM_PER_UNIT : planets[k].distance; }
+
+// synthetic scene: the generator fills the same batches, and the instances take its texture layers
+void create_synthetic_instances()
+{
+	std::vector<vec4> sphere_info, ring_info;
+	scene_radius = synthetic.generate(planet_orbits, sphere_orbits, sphere_parents, sphere_info, ring_orbits, ring_parents, ring_info);
+	sphere_instances.resize(sphere_info.size()); for(size_t k = 0; k < sphere_info.size(); k++) sphere_instances[k].info = sphere_info[k];
+	ring_instances.resize(ring_info.size()); for(size_t k = 0; k < ring_info.size(); k++) ring_instances[k].info = ring_info[k];
+	planet_positions.resize(planet_orbits.size());
+	sphere_centers.resize(sphere_parents.size());
+	ring_centers.resize(ring_parents.size());
+}
 
+void create_instances()
+{
+	sphere_orbits.clear(); sphere_instances.clear(); sphere_parents.clear();
+	ring_orbits.clear(); ring_instances.clear(); ring_parents.clear();
+	planet_orbits.clear();
+	if(synthetic.planets && !bRealScale){ create_synthetic_instances(); return; }
+	scene_radius = planets[8].distance;
+
+	// planet orbits: circles at the toy scale, J2000 elements at the real scale, where the
+	// earth keeps its toy angular speed and the periods of the others follow
 	for(uint k = 0; k < 9; k++)
 	{
-		model_matrix = mat4::scale(planets[k].radius, planets[k].radius, planets[k].radius);
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * planets[k].rotate) * model_matrix;
-		model_matrix = mat4::translate(planets[k].distance, 0, 0) * model_matrix;
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * planets[k].revolve) * model_matrix;
-
-		// especially for the sun
-		if(k == 0)
-			glUniform1i(glGetUniformLocation(program, "blinnEnabled"), 0);
-		else
-			glUniform1i(glGetUniformLocation(program, "blinnEnabled"), 1);
-
-		// bind texture
-		glBindTexture(GL_TEXTURE_2D, texture_planet[k]);
-
-		glUniformMatrix4fv(glGetUniformLocation(program, "model_matrix"), 1, GL_TRUE, model_matrix);
-		glDrawElements(GL_TRIANGLES, sphere_index_list.size(), GL_UNSIGNED_INT, nullptr);
+		const planet_scale& p = planet_scales[k]; double rad = PI / 180.0;
+		if(!bRealScale) planet_orbits.push_back(planets[k].distance, 0.0, 0.0, 0.0, 0.0, 0.0, planets[k].revolve);
+		else planet_orbits.push_back(planet_distance(k), p.e, p.i*rad, p.node*rad, p.peri*rad, p.M0*rad, p.period > 0 ? planets[3].revolve / p.period : 0.0);
 	}
+	planet_positions.resize(planet_orbits.size());
 
-	// draw dwarfs
-	glBindTexture(GL_TEXTURE_2D, texture_planet[9]); // moon texture
-	for(uint k = 0; k < 12; k++)
+	// planets: texture layer k; no shading especially for the sun
+	for(uint k = 0; k < 9; k++)
 	{
-		model_matrix = mat4::scale(dwarfs[k].info.radius, dwarfs[k].info.radius, dwarfs[k].info.radius);
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * dwarfs[k].info.rotate) * model_matrix;
-		model_matrix = mat4::translate(dwarfs[k].info.distance, 0, 0) * model_matrix;
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * dwarfs[k].info.revolve) * model_matrix;
-		model_matrix = mat4::translate(planets[dwarfs[k].planet].distance, 0, 0) * model_matrix;
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * planets[dwarfs[k].planet].revolve) * model_matrix;
-
-		glUniformMatrix4fv(glGetUniformLocation(program, "model_matrix"), 1, GL_TRUE, model_matrix);
-		glDrawElements(GL_TRIANGLES, sphere_index_list.size(), GL_UNSIGNED_INT, nullptr);
+		sphere_orbits.push_back(planet_radius(k), planets[k].rotate, planets[k].revolve, 0.0); sphere_parents.push_back(k);
+		instance_t i; i.info = vec4(float(k), k == 0 ? 0.0f : 1.0f, 0.0f, 0.0f); sphere_instances.push_back(i);
 	}
 
-	//------------------------------
-	// draw rings
-
-	// enable alpha blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glUniform1i(glGetUniformLocation(program, "blendEnabled"), 1);
-
-	// bind vertex attributes to your shader program
-	for(size_t k = 0, kn = std::extent<decltype(vertex_attrib)>::value, byte_offset = 0; k<kn; k++, byte_offset += attrib_size[k - 1])
+	// dwarfs orbit their planets, scaled along with them; moon texture for all dwarfs
+	for(uint k = 0; k < 12; k++)
 	{
-		GLuint loc = glGetAttribLocation(program, vertex_attrib[k]); if(loc >= kn) continue;
-		glEnableVertexAttribArray(loc);
-		glBindBuffer(GL_ARRAY_BUFFER, ring_vertex_buffer);
-		glVertexAttribPointer(loc, attrib_size[k] / sizeof(GLfloat), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)byte_offset);
+		uint p = dwarfs[k].planet; double s = planet_radius(p) / planets[p].radius;
+		sphere_orbits.push_back(dwarfs[k].info.radius*s, dwarfs[k].info.rotate, dwarfs[k].info.revolve, dwarfs[k].info.distance*s, 0.0, planets[p].revolve); sphere_parents.push_back(p);
+		instance_t i; i.info = vec4(9.0f, 1.0f, 0.0f, 0.0f); sphere_instances.push_back(i);
 	}
 
-	// render vertices: trigger shader programs to process vertex data
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring_index_buffer);
-
+	// rings follow the orbits of their planets without spinning
 	for(uint k = 0; k < 2; k++)
 	{
-		model_matrix = mat4::scale(rings[k].scale, rings[k].scale, rings[k].scale);
-		model_matrix = mat4::translate(planets[rings[k].planet].distance, 0, 0) * model_matrix;
-		model_matrix = mat4::rotate(vec3(0, 0, 1), t * planets[rings[k].planet].revolve) * model_matrix;
-
-		// bind texture
-		glBindTexture(GL_TEXTURE_2D, texture_ring[k]);
-
-		glUniformMatrix4fv(glGetUniformLocation(program, "model_matrix"), 1, GL_TRUE, model_matrix);
-		glDrawElements(GL_TRIANGLES, sphere_index_list.size(), GL_UNSIGNED_INT, nullptr);
+		uint p = rings[k].planet; double s = planet_radius(p) / planets[p].radius;
+		ring_orbits.push_back(rings[k].scale*s, 0.0, planets[p].revolve, 0.0); ring_parents.push_back(p);
+		instance_t i; i.info = vec4(float(k), 1.0f, 0.0f, 0.0f); ring_instances.push_back(i);
 	}
-
-	// disable alpha blending
-	glDisable(GL_BLEND);
-	glUniform1i(glGetUniformLocation(program, "blendEnabled"), 0);
-
-	//------------------------------
-	// swap front and back buffers, and display to screen
-	glfwSwapBuffers(window);
+	sphere_centers.resize(sphere_parents.size());
+	ring_centers.resize(ring_parents.size());
 }
 
-void update_and_render()
-{
-	update();
-	render();
-}
-
-void reshape(GLFWwindow* window, int width, int height)
+// the real scale starts above the inner planets and moves faster
+void reset_camera()
 {
-	window_size = ivec2(width, height);
-	glViewport(0, 0, width, height);
-	update_and_render();
+	cam = camera();
+	if(!bRealScale) return;
+	cam.origin = dvec3(0.0, 0.0, 3.0*KM_PER_AU / KM_PER_UNIT);
+	cam.eye = vec3(0.0f); cam.at = vec3(0.0f, 0.0f, -1.0f);
+	cam.speed = 1000.0f; cam.dNear = 0.01f; cam.dFar = 1e6f;
 }
 
 //*******************************************************************
@@ -214,7 +499,14 @@ void print_help()
 	printf("- press F1 or 'h' to see help\n");
 	printf("- press 'w' to toggle wireframe\n");
 	printf("- press Home to reset camera\n");
-	printf("- press Pause to pause the simulation");
+	printf("- press 'r' to toggle real scale\n");
+	printf("- press 'z' to cycle depth modes\n");
+	printf("- press 'n' to toggle the N-body simulation\n");
+	printf("- press 'g' to run the N-body simulation on the GPU\n");
+	printf("- press Pause or 'p' to pause the simulation\n");
+	printf("- press '[' or ']' to slow down or speed up time, Backspace to reverse it\n");
+	printf("- press 't' to toggle the frame profiler\n");
+	printf("- press 'c' to write a Chrome trace of the recent frames");
 	printf("\n");
 }
 
@@ -248,10 +540,67 @@ void keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 		}
 		else if (key == GLFW_KEY_HOME)
 		{
-			cam.resetCamera();
-			memcpy(&cam, &camera(), sizeof(camera));
+			reset_camera();
 			update_and_render();
 		}
+		else if(key == GLFW_KEY_R)
+		{
+			bRealScale = !bRealScale; bNBody = bNBody && bRealScale; bGPUNBody = bGPUNBody && bNBody;
+			create_instances();
+			reset_camera();
+			set_depth_mode(bRealScale ? DEPTH_REVERSED : DEPTH_STANDARD);
+			printf("> using %s scale with %s depth\n", bRealScale ? "real" : "toy", depth_mode_name[depth_mode]);
+			update_and_render();
+		}
+		else if(key == GLFW_KEY_N)
+		{
+			bNBody = !bNBody; bGPUNBody = false;
+			if(bNBody && !bRealScale){ bRealScale = true; create_instances(); reset_camera(); set_depth_mode(DEPTH_REVERSED); }
+			if(bNBody){ seed_nbody(sim.time, nbody_belt_count); printf("> simulating %d bodies (%d threads)\n", int(nbody.size()), nbody.pool.size()); }
+			else printf("> using Keplerian orbits\n");
+			update_and_render();
+		}
+		else if(key == GLFW_KEY_G)
+		{
+			if(!gpu.program){ printf("[warning] GPU N-body is unavailable\n"); return; }
+			bGPUNBody = !bGPUNBody; bNBody = true;
+			if(!bRealScale){ bRealScale = true; create_instances(); reset_camera(); set_depth_mode(DEPTH_REVERSED); }
+			seed_nbody(sim.time, bGPUNBody ? gpu_nbody_belt_count : nbody_belt_count);
+			if(bGPUNBody)
+			{
+				std::vector<float> radius; for(uint k = 0; k < 9; k++) radius.push_back(float(planet_radius(k)));
+				gpu.upload(nbody, radius, sizeof(instance_t), float(nbody.softening));
+				printf("> simulating %d bodies on the GPU\n", int(gpu.count));
+			}
+			else printf("> simulating %d bodies (%d threads)\n", int(nbody.size()), nbody.pool.size());
+			update_and_render();
+		}
+		else if(key == GLFW_KEY_Z)
+		{
+			set_depth_mode(depth_mode_t((depth_mode + 1) % DEPTH_MODE_COUNT));
+			printf("> using %s depth\n", depth_mode_name[depth_mode]);
+			update_and_render();
+		}
+		else if(key == GLFW_KEY_C) cg_trace().dump(trace_path);
+		else if(key == GLFW_KEY_T)
+		{
+			prof.set_enabled(!prof.enabled, prof.pipeline_statistics);
+			printf("> profiler %s\n", prof.enabled ? "enabled" : "disabled");
+		}
+		else if(key == GLFW_KEY_PAUSE || key == GLFW_KEY_P)
+		{
+			sim.paused = !sim.paused;
+			printf("> simulation %s\n", sim.paused ? "paused" : "resumed");
+		}
+		else if(key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET || key == GLFW_KEY_BACKSPACE)
+		{
+			// speeds from 1/64x to 64x; beyond max_steps per frame, fast-forward gives way to slow motion
+			double speed = fabs(sim.scale) / time_scale;
+			if(key == GLFW_KEY_LEFT_BRACKET) speed = max(speed*0.5, 1.0 / 64);
+			if(key == GLFW_KEY_RIGHT_BRACKET) speed = min(speed*2.0, 64.0);
+			sim.scale = speed*time_scale*(key == GLFW_KEY_BACKSPACE ? -sim.direction() : sim.direction());
+			printf("> time runs %s at %gx\n", sim.scale < 0 ? "backward" : "forward", speed);
+		}
 	}
 
 	/*
@@ -308,7 +657,7 @@ void create_vertex_buffer()
 		{
 			float t = PI / 35 * k;
 			float e = PI*2.0f / 71 * l;
-			sphere_vertex_list.push_back({
+			sphere_mesh.vertex_list.push_back({
 				vec3(radius * sin(t) * cos(e), radius * sin(t) * sin(e), radius * cos(t)),	// vertex position
 				vec3(sin(t) * cos(e), sin(t) * sin(e), cos(t)),								// normal vector
 				vec2(e / (PI*2.0f), 1 - (t / PI))											// texture coordinate in ([0,1], [0,1])
@@ -324,7 +673,7 @@ void create_vertex_buffer()
 			float c = cos(t), s = sin(t);
 			if(k == 0) radius = 1.0f;
 			else		radius = 1.8f;
-			ring_vertex_list.push_back({
+			ring_mesh.vertex_list.push_back({
 				vec3(radius * c, radius * s, 0.0f),	// vertex position
 				vec3(radius * c, radius * s, 2.0f),	// normal vector (z ٲٸ ̵ ݻ簪 )
 				vec2((float)k, (float)1 - k)		// texture coordinate in ([0,1], [0,1])
@@ -332,59 +681,122 @@ void create_vertex_buffer()
 		}
 }
 
+// attach per-instance attributes to a vertex array, from a new buffer unless one is given
+GLuint create_instance_buffer(GLuint vertex_array, GLuint instance_buffer = 0)
+{
+	if(!instance_buffer) glGenBuffers(1, &instance_buffer);
+	glBindVertexArray(vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+	// a mat4 attribute occupies four consecutive locations, one per column
+	for(GLint k = 0; k < 4 && iloc[0] >= 0; k++)
+	{
+		glEnableVertexAttribArray(iloc[0] + k);
+		glVertexAttribPointer(iloc[0] + k, 4, GL_FLOAT, GL_FALSE, sizeof(instance_t), (GLvoid*)(sizeof(vec4)*k));
+		glVertexAttribDivisor(iloc[0] + k, 1);
+	}
+	if(iloc[1] >= 0)
+	{
+		glEnableVertexAttribArray(iloc[1]);
+		glVertexAttribPointer(iloc[1], 4, GL_FLOAT, GL_FALSE, sizeof(instance_t), (GLvoid*)offsetof(instance_t, info));
+		glVertexAttribDivisor(iloc[1], 1);
+	}
+	for(GLint k = 0; k < 3 && iloc[2] >= 0; k++)	// a mat3 takes three locations of vec3 columns
+	{
+		glEnableVertexAttribArray(iloc[2] + k);
+		glVertexAttribPointer(iloc[2] + k, 3, GL_FLOAT, GL_FALSE, sizeof(instance_t), (GLvoid*)(offsetof(instance_t, normal_matrix) + sizeof(vec3)*k));
+		glVertexAttribDivisor(iloc[2] + k, 1);
+	}
+
+	glBindVertexArray(0);
+	return instance_buffer;
+}
+
 void create_index_buffer()
 {
 	// sphere
 	for(uint k = 0; k < 35; k++)
 		for(uint l = 0; l < 72; l++)
 		{
-			sphere_index_list.push_back(k * 72 + l % 72);
-			sphere_index_list.push_back((k + 1) * 72 + l % 72);
-			sphere_index_list.push_back(k * 72 + (l + 1) % 72);
+			sphere_mesh.index_list.push_back(k * 72 + l % 72);
+			sphere_mesh.index_list.push_back((k + 1) * 72 + l % 72);
+			sphere_mesh.index_list.push_back(k * 72 + (l + 1) % 72);
 
-			sphere_index_list.push_back(k * 72 + (l + 1) % 72);
-			sphere_index_list.push_back((k + 1) * 72 + l % 72);
-			sphere_index_list.push_back((k + 1) * 72 + (l + 1) % 72);
+			sphere_mesh.index_list.push_back(k * 72 + (l + 1) % 72);
+			sphere_mesh.index_list.push_back((k + 1) * 72 + l % 72);
+			sphere_mesh.index_list.push_back((k + 1) * 72 + (l + 1) % 72);
 		}
 
 	// generation of vertex buffer
-	glGenBuffers(1, &sphere_vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, sphere_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex)*sphere_vertex_list.size(), &sphere_vertex_list[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &sphere_mesh.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, sphere_mesh.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex)*sphere_mesh.vertex_list.size(), &sphere_mesh.vertex_list[0], GL_STATIC_DRAW);
 
 	// geneation of index buffer
-	glGenBuffers(1, &sphere_index_buffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere_index_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*sphere_index_list.size(), &sphere_index_list[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &sphere_mesh.index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere_mesh.index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*sphere_mesh.index_list.size(), &sphere_mesh.index_list[0], GL_STATIC_DRAW);
+
+	// record the vertex layout once into a vertex array object
+	sphere_mesh.vertex_array = cg_create_vertex_array(sphere_mesh.vertex_buffer, sphere_mesh.index_buffer, aloc);
 
 	//-----
 
 	// ring
 	for(uint k = 0; k < 32; k++)
 	{
-		ring_index_list.push_back(k);
-		ring_index_list.push_back(32 + k);
-		ring_index_list.push_back((k + 1) % 32);
+		ring_mesh.index_list.push_back(k);
+		ring_mesh.index_list.push_back(32 + k);
+		ring_mesh.index_list.push_back((k + 1) % 32);
 
-		ring_index_list.push_back((k + 1) % 32);
-		ring_index_list.push_back(32 + k);
-		ring_index_list.push_back(32 + (k + 1) % 32);
+		ring_mesh.index_list.push_back((k + 1) % 32);
+		ring_mesh.index_list.push_back(32 + k);
+		ring_mesh.index_list.push_back(32 + (k + 1) % 32);
 	}
 
 	// generation of vertex buffer
-	glGenBuffers(1, &ring_vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, ring_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex)*ring_vertex_list.size(), &ring_vertex_list[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &ring_mesh.vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, ring_mesh.vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex)*ring_mesh.vertex_list.size(), &ring_mesh.vertex_list[0], GL_STATIC_DRAW);
 
 	// geneation of index buffer
-	glGenBuffers(1, &ring_index_buffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring_index_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*ring_index_list.size(), &ring_index_list[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &ring_mesh.index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring_mesh.index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*ring_mesh.index_list.size(), &ring_mesh.index_list[0], GL_STATIC_DRAW);
+
+	// record the vertex layout once into a vertex array object
+	ring_mesh.vertex_array = cg_create_vertex_array(ring_mesh.vertex_buffer, ring_mesh.index_buffer, aloc);
+
+	// attach per-instance buffers to the vertex arrays
+	sphere_instance_buffer = create_instance_buffer(sphere_mesh.vertex_array);
+	ring_instance_buffer = create_instance_buffer(ring_mesh.vertex_array);
+
+	// particles: positions only
+	glGenBuffers(1, &particle_buffer);
+	glGenVertexArrays(1, &particle_vertex_array);
+	glBindVertexArray(particle_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, particle_buffer);
+	glEnableVertexAttribArray(aloc[0]);
+	glVertexAttribPointer(aloc[0], 3, GL_FLOAT, GL_FALSE, sizeof(vec3), nullptr);
+	glBindVertexArray(0);
+
+	// GPU N-body: the sphere mesh again with the instances of near bodies, and the points of far ones (vec4 each)
+	if(!gpu.program) return;
+	gpu_sphere_vertex_array = cg_create_vertex_array(sphere_mesh.vertex_buffer, sphere_mesh.index_buffer, aloc);
+	create_instance_buffer(gpu_sphere_vertex_array, gpu.instances);
+	glGenVertexArrays(1, &gpu_point_vertex_array);
+	glBindVertexArray(gpu_point_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, gpu.points);
+	glEnableVertexAttribArray(aloc[0]);
+	glVertexAttribPointer(aloc[0], 3, GL_FLOAT, GL_FALSE, sizeof(vec4), nullptr);
+	glBindVertexArray(0);
 }
 
 //*******************************************************************
 bool user_init()
 {
+	trace_scope scope("user_init");
+
 	// log hotkeys
 	print_help();
 
@@ -398,110 +810,172 @@ bool user_init()
 	glfwSetCursorPos(window, window_size.x / 2, window_size.y / 2);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 
+	// resolve uniform/attribute locations once; the per-frame path never looks up names
+	resolve_locations();
+
+	// simulation clock: a fixed step is one N-body step
+	sim.step = nbody_dt / nbody_years(1.0);
+	sim.scale = time_scale;
+
+	// compute program of the GPU N-body, if compute shaders are there
+	gpu.create(nbody_comp_path);
+	if(!gpu_nbody_belt_count) gpu_nbody_belt_count = cg_software_renderer() ? 2048 : 32768;	// all pairs take seconds per frame on a software rasterizer
+
+	// timer queries of the profiler, which starts disabled
+	prof.create(profile_phase_name, PROFILE_PHASE_COUNT);
+
 	// create vertex buffer and index buffer
 	create_vertex_buffer();
 	create_index_buffer();
+	create_instances();
 
-	// texture processing
-	int width, height, comp = 3;
-	unsigned char* pimage0;
-	unsigned char* pimage;
-	int stride0, stride1;
-	for(int i = 0; i < 10; i++) // planets
-	{
-		// load and flip an image
-		pimage0 = stbi_load(texture_planet_path[i], &width, &height, &comp, 3); if(comp == 1) comp = 3; /* convert 1-channel to 3-channel image */
-		stride0 = width*comp;
-		stride1 = (stride0 + 3)&(~3);	// 4-byte aligned stride
-		pimage = (unsigned char*)malloc(sizeof(unsigned char)*stride1*height);
-		for(int y = 0; y < height; y++) memcpy(pimage + (height - 1 - y)*stride1, pimage0 + y*stride0, stride0); // vertical flip
-
-		// create textures
-		glGenTextures(1, &texture_planet[i]);
-		glBindTexture(GL_TEXTURE_2D, texture_planet[i]);
-
-		// allocate and create mipmap
-		int mip_levels = get_mip_levels(window_size.x, window_size.y);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8 /* GL_RGB for legacy GL */, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pimage);
-		for(int k = 1, w = width >> 1, h = height >> 1; k<mip_levels; k++, w = max(1, w >> 1), h = max(1, h >> 1))
-			glTexImage2D(GL_TEXTURE_2D, k, GL_RGB8 /* GL_RGB for legacy GL */, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// configure texture parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-
-		// release the new image
-		free(pimage);
-	}
-	for(int i = 0; i < 2; i++) // rings
-	{
-		// load and flip an image
-		pimage0 = stbi_load(texture_ring_path[i], &width, &height, &comp, 3); if(comp == 1) comp = 3; /* convert 1-channel to 3-channel image */
-		stride0 = width*comp;
-		stride1 = (stride0 + 3)&(~3);	// 4-byte aligned stride
-		pimage = (unsigned char*)malloc(sizeof(unsigned char)*stride1*height);
-		for(int y = 0; y < height; y++) memcpy(pimage + (height - 1 - y)*stride1, pimage0 + y*stride0, stride0); // vertical flip
-
-		// create textures
-		glGenTextures(1, &texture_ring[i]);
-		glBindTexture(GL_TEXTURE_2D, texture_ring[i]);
-
-		// allocate and create mipmap
-		int mip_levels = get_mip_levels(window_size.x, window_size.y);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8 /* GL_RGB for legacy GL */, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pimage);
-		for(int k = 1, w = width >> 1, h = height >> 1; k<mip_levels; k++, w = max(1, w >> 1), h = max(1, h >> 1))
-			glTexImage2D(GL_TEXTURE_2D, k, GL_RGB8 /* GL_RGB for legacy GL */, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// configure texture parameters	
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-
-		// release the new image
-		free(pimage);
-	}
+	// texture processing: planet surfaces and rings go to one array texture each
+	// the arrays start with average-color placeholders and the images are decoded in the background
+	if(!(texture_planet = streamer.add_array(texture_planet_path, 10, true))) return false;	// BC1 through the texture cache
+	if(!(texture_ring = streamer.add_array(texture_ring_path, 2))) return false;
+	streamer.start();
+
+	// both arrays are sampled through unit 0: each pass binds its own array once
+	glUseProgram(program);
+	glUniform1i(uloc.TEX, 0); // GL_TEXTURE0
 
 	return true;
 }
 
 void user_finalize()
 {
+	depth_target.release();
+	prof.release();
+	bench.release();
+	gpu.release();
+	nbody.pool.stop();
+	streamer.release();
 }
 
 //*******************************************************************
-void main(int argc, char* argv[])
+// pack builder: "--build-pack [pack] [files...]" packs the given files, or the shaders and textures of this app
+bool build_asset_pack(int argc, char* argv[])
 {
+	const char* pack_path = argc > 2 ? argv[2] : asset_pack_path;
+	std::vector<const char*> files(argv + min(argc, 3), argv + argc);
+	if(files.empty())
+	{
+		files.push_back(vert_shader_path);
+		files.push_back(frag_shader_path);
+		files.push_back(nbody_comp_path);
+		for(int k = 0; k < 10; k++) files.push_back(texture_planet_path[k]);
+		for(int k = 0; k < 2; k++) files.push_back(texture_ring_path[k]);
+	}
+	return build_pack(pack_path, &files[0], int(files.size()));
+}
+
+// benchmark: wait for every texture, switch to the scene through its hotkey or generate it, and record the frames from there
+void start_bench(int frames, const char* scene, int bodies)
+{
+	while(streamer.pending()){ streamer.update(); std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+	bench.create(frames);	// before the hotkey, whose frame already takes the time of the benchmark
+	size_t belt = bodies > 0 ? size_t(max(bodies, int(nbody_major_count))) - nbody_major_count : 0;
+	if(belt && strcmp(scene, "nbody") == 0) nbody_belt_count = belt;
+	if(belt && strcmp(scene, "gpu") == 0) gpu_nbody_belt_count = belt;
+	int key = strcmp(scene, "real") == 0 ? GLFW_KEY_R : strcmp(scene, "nbody") == 0 ? GLFW_KEY_N : strcmp(scene, "gpu") == 0 ? GLFW_KEY_G : 0;
+	if(key) keyboard(window, key, 0, GLFW_PRESS, 0);
+	else if(strcmp(scene, "synth") == 0)
+	{
+		synthetic = synthetic_scene::with_bodies(bodies > 0 ? size_t(bodies) : 10000);
+		create_instances();
+		printf("> generated %d planets with %d moons and %d rings: %d bodies\n", int(synthetic.planets), int(synthetic.planets*synthetic.moons*(1 + synthetic.submoons)), int(ring_instances.size()), int(sphere_instances.size()));
+	}
+	else if(strcmp(scene, "toy") != 0) printf("[warning] unknown benchmark scene %s; using the toy scene\n", scene);
+}
+
+void report_bench()
+{
+	const char* scene = bGPUNBody ? "gpu" : bNBody ? "nbody" : bRealScale ? "real" : synthetic.planets ? "synth" : "toy";
+	bench.report(scene, bGPUNBody ? gpu.count : bNBody ? nbody.size() : sphere_instances.size() + ring_instances.size(), &prof);
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc > 1 && strcmp(argv[1], "--build-pack") == 0) return build_asset_pack(argc, argv) ? 0 : 1;
+	if(argc > 1 && strcmp(argv[1], "--bench-kepler") == 0){ kepler_benchmark(argc > 2 ? size_t(atoi(argv[2])) : 1 << 20); return 0; }	// "--bench-kepler [bodies]"
+	if(argc > 1 && strcmp(argv[1], "--bench-nbody") == 0){ nbody_benchmark(argc > 2 ? size_t(atoi(argv[2])) : 100000); return 0; }	// "--bench-nbody [bodies]"
+
+	// "--frames n" stops after n frames and reports the frame rate; headless runs have no other way to stop
+	int frame_limit = 0;
+	for(int k = 1; k + 1 < argc; k++) if(strcmp(argv[k], "--frames") == 0) frame_limit = atoi(argv[k + 1]);
+
+	// "--bench [frames] [toy|real|nbody [bodies]|gpu [bodies]|synth [bodies]]" records the frames of a scripted flight and prints their statistics
+	int bench_frames = 0, bench_bodies = 0; const char* bench_scene = "toy";
+	for(int k = 1; k < argc; k++) if(strcmp(argv[k], "--bench") == 0)
+	{
+		bench_frames = 600;
+		for(int j = k + 1; j < argc && argv[j][0] != '-'; j++)
+		{
+			if(!isdigit(argv[j][0])) bench_scene = argv[j];
+			else if(strcmp(bench_scene, "toy") != 0 && strcmp(bench_scene, "real") != 0) bench_bodies = atoi(argv[j]);	// a number after the scene is its size
+			else bench_frames = atoi(argv[j]);
+		}
+	}
+#ifdef CG_HEADLESS
+	if(frame_limit <= 0 && bench_frames <= 0) frame_limit = 300;
+#endif
+
+	// "--profile [stats]" starts with the profiler on, and also counts shader invocations with "stats"
+	int profile = 0;
+	for(int k = 1; k < argc; k++) if(strcmp(argv[k], "--profile") == 0) profile = k + 1 < argc && strcmp(argv[k + 1], "stats") == 0 ? 2 : 1;
+
+	// "--trace [path]" writes the Chrome trace of the last events at exit
+	const char* exit_trace_path = nullptr;
+	for(int k = 1; k < argc; k++) if(strcmp(argv[k], "--trace") == 0) exit_trace_path = k + 1 < argc && argv[k + 1][0] != '-' ? argv[k + 1] : trace_path;
+	cg_trace().name_thread("main");
+
+	// "--pack [path]" maps an asset pack, and shaders and textures are then read in place; it is opt-in,
+	// since a pack is not rebuilt when the loose files are edited
+	const char* pack_path = nullptr;
+	for(int k = 1; k < argc; k++) if(strcmp(argv[k], "--pack") == 0) pack_path = k + 1 < argc && argv[k + 1][0] != '-' ? argv[k + 1] : asset_pack_path;
+	if(pack_path && cg_assets().open(pack_path)) printf("> using %s (%d assets)\n", pack_path, int(cg_assets().count));
+	else if(pack_path) printf("[warning] unable to open %s; using loose files\n", pack_path);
+
 	// initialization
-	if(!glfwInit()){ printf("1[error] failed in glfwInit()\n"); return; }
+	if(!glfwInit()){ printf("1[error] failed in glfwInit()\n"); return 1; }
 
 	// create window and initialize OpenGL extensions
-	if(!(window = cg_create_window(window_name, window_size.x, window_size.y))){ glfwTerminate(); return; }
-	if(!cg_init_extensions(window)){ glfwTerminate(); return; }	// init OpenGL extensions
+	if(!(window = cg_create_window(window_name, window_size.x, window_size.y))){ glfwTerminate(); return 1; }
+	if(!cg_init_extensions(window)){ glfwTerminate(); return 1; }	// init OpenGL extensions
 
 	// initializations and validations of GLSL program
-	if(!(program = cg_create_program(vert_shader_path, frag_shader_path))){ glfwTerminate(); return; }	// create and compile shaders/program
-	if(!user_init()){ printf("Failed to user_init()\n"); glfwTerminate(); return; }					// user initialization
+	if(!(program = cg_create_program(vert_shader_path, frag_shader_path))){ glfwTerminate(); return 1; }	// create and compile shaders/program
+	if(!user_init()){ printf("Failed to user_init()\n"); glfwTerminate(); return 1; }					// user initialization
 
 	// register event callbacks
 	glfwSetWindowSizeCallback(window, reshape);		// callback for window resizing events
 	glfwSetKeyCallback(window, keyboard);			// callback for keyboard events
 	glfwSetMouseButtonCallback(window, mouse);		// callback for mouse click inputs
 	glfwSetCursorPosCallback(window, motion);		// callback for mouse movements
+	if(profile) prof.set_enabled(true, profile > 1);
+	if(bench_frames > 0) start_bench(bench_frames, bench_scene, bench_bodies);
 
 	// enters rendering/event loop
+	double loop_start = glfwGetTime();
 	for(frame = 0; !glfwWindowShouldClose(window); frame++)
 	{
+		trace_scope scope("frame");
 		glfwPollEvents();		// polling and processing of events
+		if(bench.active()) bench.begin_frame();
 		update_and_render();	// per-frame update/render
+		if(bench.active()){ bench.end_frame(draw_calls); if(bench.done()) glfwSetWindowShouldClose(window, GL_TRUE); }
+		prof.end_frame();
+		if(prof.enabled && !bench.active() && frame % PROFILE_HISTORY == PROFILE_HISTORY - 1) prof.print();	// once per window of statistics
+		if(frame == 0) printf("> first frame at %.1f ms\n", glfwGetTime()*1000.0);
+		if(frame + 1 == frame_limit) glfwSetWindowShouldClose(window, GL_TRUE);
 	}
+	if(frame_limit > 0){ double elapsed = glfwGetTime() - loop_start; printf("> %d frames in %.2f s: %.1f fps\n", frame, elapsed, frame / elapsed); }
+	if(bench.active()) report_bench();
+	if(exit_trace_path) cg_trace().dump(exit_trace_path);
 
 	// normal termination
 	user_finalize();
 	glfwDestroyWindow(window);
 	glfwTerminate();
+	return 0;
 }
\ No newline at end of file
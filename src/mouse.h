@@ -5,6 +5,8 @@ struct camera
 	vec3	eye = vec3(0, 0, 10);
 	vec3	at = vec3(0, 0, 0);
 	vec3	up = vec3(0, 1, 0);
+	dvec3	origin = dvec3(0.0);	// floating origin: eye and at are relative to it, so the view stays near zero
+	float	speed = 1.0f;			// scale of WASD movement
 	mat4	view_matrix = mat4::lookAt(eye, at, up);
 
 	float	fovy = PI / 4.0f; // must be in radian
@@ -20,6 +22,14 @@ struct camera
 		sphere_angle = vec2(90.0, 180.0);
 	}
 
+	// move the origin to the eye once it drifts beyond threshold, before float loses precision
+	void recenter(float threshold)
+	{
+		if(eye.length() < threshold) return;
+		origin += dvec3(eye.x, eye.y, eye.z);
+		at -= eye; eye = vec3(0.0f);
+	}
+
 	void applyFirstPerson(ivec2 window_size, double x, double y)
 	{
 		ivec2 window_center = window_size / 2;
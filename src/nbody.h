@@ -0,0 +1,255 @@
+#pragma once
+#ifndef __NBODY_H__
+#define __NBODY_H__
+
+#include "parallel.h"
+
+//*******************************************************************
+// N-body gravity in AU, years, and solar masses: a kick-drift-kick leapfrog (symplectic,
+// so orbits do not drift in energy) over forces from direct summation for small systems
+// or a Barnes-Hut octree for large ones, evaluated on a work-stealing pool
+static const double	NBODY_G = 39.478417604357434;	// 4*pi^2 AU^3/(Msun*yr^2)
+static const double	NBODY_THETA = 0.75;				// opening angle of Barnes-Hut cells
+static const size_t	NBODY_DIRECT_MAX = 1024;		// direct summation up to this many bodies
+static const int	OCTREE_LEAF_SIZE = 8;			// bodies per leaf before it splits
+static const int	OCTREE_MAX_DEPTH = 40;			// coincident bodies stay in one leaf beyond this
+
+struct octree_node
+{
+	dvec3	center;			// of the cubic cell
+	double	half;			// half of the cell edge
+	dvec3	com;			// center of mass of the bodies below
+	double	mass;
+	int		child[8];		// octant (x>=cx)|(y>=cy)<<1|(z>=cz)<<2; -1 for empty
+	int		first;			// leaves: head of the body list chained through octree::next
+	int		count;			// leaves: number of bodies; -1 for internal cells
+	int		begin;			// leaves: first body in octree::order
+};
+
+struct octree
+{
+	std::vector<octree_node>	nodes;		// root first
+	std::vector<int>			next;		// body lists of the leaves
+	std::vector<int>			order;		// bodies leaf by leaf: neighbors in this order walk nearly the same cells
+	std::vector<dvec3>			leaf_position;	// position and mass in that order, so leaves are read contiguously
+	std::vector<double>			leaf_mass;
+
+	void build(const std::vector<dvec3>& position, const std::vector<double>& mass)
+	{
+		dvec3 lo = position[0], hi = position[0];
+		for(auto& p : position) for(int c = 0; c < 3; c++){ lo[c] = min(lo[c], p[c]); hi[c] = max(hi[c], p[c]); }
+		dvec3 extent = hi - lo;
+		nodes.clear(); next.assign(position.size(), -1); order.clear(); leaf_position.clear(); leaf_mass.clear();
+		add_leaf((lo + hi)*0.5, max(max(extent.x, extent.y), max(extent.z, 1e-12))*0.5001);
+		for(int k = 0, n = int(position.size()); k < n; k++) insert(k, position);
+		summarize(0, position, mass);
+	}
+
+	int add_leaf(const dvec3& center, double half)
+	{
+		octree_node c; c.center = center; c.half = half; c.mass = 0; c.first = -1; c.count = 0; c.begin = 0;
+		for(int k = 0; k < 8; k++) c.child[k] = -1;
+		nodes.push_back(c); return int(nodes.size()) - 1;
+	}
+
+	inline int octant(const octree_node& c, const dvec3& p) const { return (p.x >= c.center.x ? 1 : 0) | (p.y >= c.center.y ? 2 : 0) | (p.z >= c.center.z ? 4 : 0); }
+
+	// descend to the cell of body k, creating and splitting cells on the way; indices, not references, survive reallocation
+	void insert(int k, const std::vector<dvec3>& position)
+	{
+		for(int n = 0, depth = 0;; depth++)
+		{
+			if(nodes[n].count >= 0)
+			{
+				if(nodes[n].count < OCTREE_LEAF_SIZE || depth >= OCTREE_MAX_DEPTH){ next[k] = nodes[n].first; nodes[n].first = k; nodes[n].count++; return; }
+				split(n, position);
+			}
+			int o = octant(nodes[n], position[k]), c = nodes[n].child[o];
+			if(c < 0)
+			{
+				double h = nodes[n].half*0.5; dvec3 d((o & 1) ? h : -h, (o & 2) ? h : -h, (o & 4) ? h : -h);
+				c = add_leaf(nodes[n].center + d, h); nodes[n].child[o] = c;
+			}
+			n = c;
+		}
+	}
+
+	// turn a full leaf into an internal cell and push its bodies one level down
+	void split(int n, const std::vector<dvec3>& position)
+	{
+		int list = nodes[n].first; nodes[n].first = -1; nodes[n].count = -1;
+		while(list >= 0)
+		{
+			int k = list; list = next[k];
+			int o = octant(nodes[n], position[k]), c = nodes[n].child[o];
+			if(c < 0)
+			{
+				double h = nodes[n].half*0.5; dvec3 d((o & 1) ? h : -h, (o & 2) ? h : -h, (o & 4) ? h : -h);
+				c = add_leaf(nodes[n].center + d, h); nodes[n].child[o] = c;
+			}
+			next[k] = nodes[c].first; nodes[c].first = k; nodes[c].count++;
+		}
+	}
+
+	void summarize(int n, const std::vector<dvec3>& position, const std::vector<double>& mass)
+	{
+		double m = 0; dvec3 mp(0.0); nodes[n].begin = int(order.size());
+		for(int k = nodes[n].first; k >= 0; k = next[k]){ m += mass[k]; mp += position[k] * mass[k]; order.push_back(k); leaf_position.push_back(position[k]); leaf_mass.push_back(mass[k]); }
+		for(int o = 0; o < 8; o++)
+		{
+			int c = nodes[n].child[o]; if(c < 0) continue;
+			summarize(c, position, mass); m += nodes[c].mass; mp += nodes[c].com*nodes[c].mass;
+		}
+		nodes[n].mass = m; nodes[n].com = m > 0 ? mp / m : nodes[n].center;
+	}
+
+	// acceleration of body i: cells that look smaller than theta from the body act through their center of mass
+	dvec3 acceleration(int i, const dvec3& p, double theta, double eps2) const
+	{
+		dvec3 a(0.0); double theta2 = theta*theta;
+		int stack[8 * OCTREE_MAX_DEPTH + 8], top = 0; stack[top++] = 0;
+		while(top > 0)
+		{
+			const octree_node& c = nodes[stack[--top]];
+			if(c.count >= 0)
+			{
+				for(int k = c.begin, end = c.begin + c.count; k < end; k++)
+				{
+					if(order[k] == i) continue;
+					dvec3 d = leaf_position[k] - p; double r2 = d.length2() + eps2;
+					a += d*(leaf_mass[k] / (r2*sqrt(r2)));
+				}
+				continue;
+			}
+			dvec3 d = c.com - p; double r2 = d.length2() + eps2, size = 2 * c.half;
+			if(size*size < theta2*r2) a += d*(c.mass / (r2*sqrt(r2)));
+			else for(int o = 0; o < 8; o++) if(c.child[o] >= 0) stack[top++] = c.child[o];
+		}
+		return a*NBODY_G;
+	}
+};
+
+//*******************************************************************
+struct nbody_system
+{
+	std::vector<dvec3>	position, velocity, acceleration;
+	std::vector<dvec3>	previous;				// positions before the latest step, to interpolate in between
+	std::vector<double>	mass;
+	double				time = 0;				// years
+	double				softening = 1e-6;		// AU; keeps close encounters finite
+	double				theta = NBODY_THETA;
+	octree				tree;
+	work_stealing_pool	pool;
+	double				build_time = 0, force_time = 0;	// seconds spent in the last step
+
+	inline size_t size() const { return position.size(); }
+	inline void clear(){ position.clear(); velocity.clear(); acceleration.clear(); previous.clear(); mass.clear(); time = 0; }
+	inline dvec3 interpolate(size_t k, double alpha) const { return k < previous.size() ? previous[k] + (position[k] - previous[k])*alpha : position[k]; }
+	inline void add(const dvec3& p, const dvec3& v, double m){ position.push_back(p); velocity.push_back(v); acceleration.push_back(dvec3(0.0)); mass.push_back(m); }
+
+	// move to the barycentric frame so the system does not drift away
+	void recenter()
+	{
+		double m = 0; dvec3 mp(0.0), mv(0.0);
+		for(size_t k = 0; k < size(); k++){ m += mass[k]; mp += position[k] * mass[k]; mv += velocity[k] * mass[k]; }
+		if(m <= 0) return;
+		for(size_t k = 0; k < size(); k++){ position[k] -= mp / m; velocity[k] -= mv / m; }
+	}
+
+	void compute_accelerations()
+	{
+		typedef std::chrono::high_resolution_clock clock;
+		int n = int(size()); double eps2 = softening*softening;
+		auto t0 = clock::now();
+		bool direct = size() <= NBODY_DIRECT_MAX;
+		if(!direct) tree.build(position, mass);
+		auto t1 = clock::now();
+		pool.parallel_for(size(), direct ? 64 : 256, [&](size_t begin, size_t end)
+		{
+			for(int j = int(begin); j < int(end); j++)
+			{
+				if(!direct){ int i = tree.order[j]; acceleration[i] = tree.acceleration(i, position[i], theta, eps2); continue; }
+				int i = j;
+				dvec3 a(0.0), p = position[i];
+				for(int k = 0; k < n; k++){ if(k == i) continue; dvec3 d = position[k] - p; double r2 = d.length2() + eps2; a += d*(mass[k] / (r2*sqrt(r2))); }
+				acceleration[i] = a*NBODY_G;
+			}
+		});
+		auto t2 = clock::now();
+		build_time = std::chrono::duration<double>(t1 - t0).count();
+		force_time = std::chrono::duration<double>(t2 - t1).count();
+	}
+
+	// kick-drift-kick; accelerations must be current on entry, as after compute_accelerations()
+	// the scheme is time-reversible, so a negative dt retraces the steps taken forward
+	void step(double dt)
+	{
+		previous = position;
+		pool.parallel_for(size(), 4096, [&](size_t begin, size_t end){ for(size_t k = begin; k < end; k++){ velocity[k] += acceleration[k] * (dt*0.5); position[k] += velocity[k] * dt; } });
+		compute_accelerations();
+		pool.parallel_for(size(), 4096, [&](size_t begin, size_t end){ for(size_t k = begin; k < end; k++) velocity[k] += acceleration[k] * (dt*0.5); });
+		time += dt;
+	}
+};
+
+// bodies on Keplerian orbits around body central at time t in years; the mean motions in b should follow NBODY_G
+inline void add_kepler_bodies(nbody_system& s, size_t central, const kepler_batch& b, const double* masses, double t = 0)
+{
+	dvec3 cp = s.position[central], cv = s.velocity[central];
+	for(size_t k = 0; k < b.size(); k++){ dvec3 p, v; kepler_state(b, k, t, p, v); s.add(cp + p, cv + v, masses[k]); }
+}
+
+inline double kepler_mean_motion(double a, double central_mass){ return sqrt(NBODY_G*central_mass / (a*a*a)); }
+
+// a belt of count bodies of equal mass with random elements, e.g., the asteroid belt between 2.1 and 3.3 AU;
+// a generator of our own leaves rand() alone and makes the same belt on every platform
+inline void add_belt(nbody_system& s, size_t central, size_t count, double a_min, double a_max, double max_e, double max_i, double total_mass, uint seed = 1)
+{
+	unsigned long long state = seed * 0x9E3779B97F4A7C15ULL + 1;
+	auto uniform = [&](double lo, double hi){ state = state * 6364136223846793005ULL + 1442695040888963407ULL; return lo + (hi - lo)*double(state >> 11) / double(1ULL << 53); };
+	kepler_batch b; std::vector<double> masses(count, total_mass / max(count, size_t(1)));
+	for(size_t k = 0; k < count; k++)
+	{
+		// one draw per statement: the order of evaluating arguments is unspecified
+		double a = uniform(a_min, a_max), e = uniform(0, max_e), i = uniform(0, max_i), node = uniform(0, 2 * PI), peri = uniform(0, 2 * PI), M0 = uniform(0, 2 * PI);
+		b.push_back(a, e, i, node, peri, M0, kepler_mean_motion(a, s.mass[central]));
+	}
+	if(count) add_kepler_bodies(s, central, b, &masses[0]);
+}
+
+//*******************************************************************
+// scaling of one step over thread counts, and the Barnes-Hut error against direct summation
+inline void nbody_benchmark(size_t count, int repeat = 5)
+{
+	nbody_system s; s.add(dvec3(0.0), dvec3(0.0), 1.0);
+	add_belt(s, 0, count, 2.1, 3.3, 0.15, 0.17, 1e-6);
+
+	int hardware = max(1, int(std::thread::hardware_concurrency())); double base = 0;
+	printf("> nbody: %d bodies, %s\n", int(s.size()), s.size() <= NBODY_DIRECT_MAX ? "direct summation" : "Barnes-Hut");
+	for(int threads = 1;; threads = min(threads * 2, hardware))
+	{
+		s.pool.start(threads);
+		typedef std::chrono::high_resolution_clock clock;
+		auto t0 = clock::now(); double build = 0;
+		for(int r = 0; r < repeat; r++){ s.step(1e-3); build += s.build_time; }
+		double t = std::chrono::duration<double>(clock::now() - t0).count() / repeat; if(threads == 1) base = t;
+		printf("  %2d threads: %.1f ms per step (tree build %.1f ms), %.2fx, %d steals\n", threads, t*1000.0, build / repeat*1000.0, base / t, int(s.pool.steals));
+		if(threads == hardware) break;
+	}
+
+	// rms error of the tree relative to the rms force, on a sample of belt bodies; the central body is left
+	// out of both, since its force is a million times the belt's and would hide any error of the tree
+	if(s.size() > NBODY_DIRECT_MAX)
+	{
+		double e2 = 0, a2 = 0, eps2 = s.softening*s.softening; int n = int(s.size());
+		auto pull = [&](int i, int k){ dvec3 d = s.position[k] - s.position[i]; double r2 = d.length2() + eps2; return d*(NBODY_G*s.mass[k] / (r2*sqrt(r2))); };
+		for(int i = 1; i < n; i += max(1, n / 256))
+		{
+			dvec3 a(0.0); for(int k = 1; k < n; k++) if(k != i) a += pull(i, k);
+			e2 += (s.acceleration[i] - pull(i, 0) - a).length2(); a2 += a.length2();
+		}
+		printf("  rms relative force error (theta %.2f): %.1e\n", s.theta, sqrt(e2 / a2));
+	}
+}
+
+#endif // __NBODY_H__
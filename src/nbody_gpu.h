@@ -0,0 +1,124 @@
+#pragma once
+#ifndef __NBODY_GPU_H__
+#define __NBODY_GPU_H__
+
+//*******************************************************************
+// N-body on the GPU (GL 4.3): a compute shader integrates the bodies in shader storage buffers
+// with the same kick-drift-kick leapfrog as nbody_system, over all pairs in shared-memory tiles,
+// then turns them into draw data in place: sphere instances for near bodies and points for far
+// ones, counted into indirect draw commands, so the draws read the simulation without a readback
+static const uint	GPU_NBODY_GROUP_SIZE = 256;		// local_size_x of the compute shader
+static const float	GPU_NBODY_NEAR_PIXELS = 1.0f;	// bodies with a larger radius on screen are drawn as spheres
+
+struct gpu_nbody
+{
+	GLuint	program = 0;
+	GLuint	position = 0;		// vec4 per body, xyz in AU relative to the barycenter, w: mass
+	GLuint	velocity = 0;		// vec4 per body, xyz in AU/year, w: radius in scene units
+	GLuint	acceleration = 0;
+	GLuint	previous = 0;		// positions before the latest step, to interpolate in between
+	GLuint	instances = 0;		// sphere instances of near bodies; attached to a vertex array by the app
+	GLuint	points = 0;			// vec4 camera-relative positions of far bodies
+	GLuint	commands = 0;		// DrawElementsIndirectCommand at 0, then DrawArraysIndirectCommand
+	uint	count = 0;
+	double	time = 0;			// years
+	struct { GLint stage, count, dt, eps2, view_matrix, origin, unit_scale, near_ratio, alpha, instance_stride; } uloc;
+
+	static bool supported(){ return GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object); }
+	static GLvoid* point_command(){ return (GLvoid*)(sizeof(uint) * 5); }	// offset for glDrawArraysIndirect()
+
+	bool create(const char* comp_path)
+	{
+		if(!supported()){ printf("[warning] GPU N-body needs compute shaders (GL 4.3)\n"); return false; }
+		if(!(program = cg_create_compute_program(comp_path))) return false;
+
+		program_info info = cg_reflect_program(program);
+		uloc.stage				= info.uniform("stage", GL_INT);
+		uloc.count				= info.uniform("count", GL_UNSIGNED_INT);
+		uloc.dt					= info.uniform("dt", GL_FLOAT);
+		uloc.eps2				= info.uniform("eps2", GL_FLOAT);
+		uloc.view_matrix		= info.uniform("view_matrix", GL_FLOAT_MAT4);
+		uloc.origin				= info.uniform("origin", GL_FLOAT_VEC3);
+		uloc.unit_scale			= info.uniform("unit_scale", GL_FLOAT);
+		uloc.near_ratio			= info.uniform("near_ratio", GL_FLOAT);
+		uloc.alpha				= info.uniform("alpha", GL_FLOAT);
+		uloc.instance_stride	= info.uniform("instance_stride", GL_UNSIGNED_INT);
+
+		GLuint* buffers[] = { &position, &velocity, &acceleration, &previous, &instances, &points, &commands };
+		for(auto* b : buffers) glGenBuffers(1, b);
+		return true;
+	}
+
+	void release()
+	{
+		GLuint buffers[] = { position, velocity, acceleration, previous, instances, points, commands };
+		glDeleteBuffers(7, buffers);
+		if(program) glDeleteProgram(program);
+		*this = gpu_nbody();
+	}
+
+	// copy the state of a CPU system; radius[k] of the first radius.size() bodies makes them drawable as spheres
+	void upload(const nbody_system& s, const std::vector<float>& radius, size_t instance_size, float softening)
+	{
+		count = uint(s.size()); time = s.time;
+		std::vector<vec4> p(count), v(count), a(count);
+		dvec3 zero(0.0);
+		for(uint k = 0; k < count; k++)
+		{
+			p[k] = vec4(relative_to(s.position[k], zero), float(s.mass[k]));
+			v[k] = vec4(relative_to(s.velocity[k], zero), k < radius.size() ? radius[k] : 0.0f);
+			a[k] = vec4(relative_to(s.acceleration[k], zero), 0.0f);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, position); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vec4)*count, &p[0], GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocity); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vec4)*count, &v[0], GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, acceleration); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vec4)*count, &a[0], GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, previous); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vec4)*count, &p[0], GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, instances); glBufferData(GL_SHADER_STORAGE_BUFFER, instance_size*count, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, points); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vec4)*count, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commands); glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint) * 9, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		// set without binding, so the drawing program stays current
+		glProgramUniform1ui(program, uloc.count, count);
+		glProgramUniform1f(program, uloc.eps2, softening*softening);
+		glProgramUniform1ui(program, uloc.instance_stride, GLuint(instance_size / sizeof(float)));
+	}
+
+	void dispatch(int stage)
+	{
+		GLuint buffers[] = { position, velocity, acceleration, instances, commands, points, previous };
+		for(GLuint k = 0; k < 7; k++) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, k, buffers[k]);
+		glUniform1i(uloc.stage, stage);
+		glDispatchCompute((count + GPU_NBODY_GROUP_SIZE - 1) / GPU_NBODY_GROUP_SIZE, 1, 1);
+	}
+
+	// one leapfrog step; every stage reads what the previous one wrote
+	void step(float dt)
+	{
+		glUseProgram(program);
+		glUniform1f(uloc.dt, dt);
+		dispatch(0); glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		dispatch(1); glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		time += dt;
+	}
+
+	// fill the instance and point buffers for this view; near_ratio is the radius/distance of a near body
+	// and alpha places the bodies between their positions before and after the latest step
+	void emit(const mat4& view_matrix, const dvec3& origin, float unit_scale, float near_ratio, float alpha, uint index_count)
+	{
+		uint reset[9] = { index_count, 0, 0, 0, 0, 0, 1, 0, 0 };	// no sphere instances and no points yet
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commands); glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(reset), reset);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		glUseProgram(program);
+		glUniformMatrix4fv(uloc.view_matrix, 1, GL_TRUE, view_matrix);
+		glUniform3f(uloc.origin, float(origin.x), float(origin.y), float(origin.z));
+		glUniform1f(uloc.unit_scale, unit_scale);
+		glUniform1f(uloc.near_ratio, near_ratio);
+		glUniform1f(uloc.alpha, alpha);
+		dispatch(2);
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+};
+
+#endif // __NBODY_GPU_H__
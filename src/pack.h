@@ -0,0 +1,163 @@
+#pragma once
+#ifndef __PACK_H__
+#define __PACK_H__
+
+// asset pack: shaders, textures and meshes in one read-only file that is memory-mapped
+// at startup; assets are then read in place instead of being opened one by one
+#if defined(_WIN32)||defined(_WIN64)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+//*******************************************************************
+// file layout: header | blobs, each aligned to PACK_ALIGN and followed by at least one zero byte | table of contents
+static const uint PACK_MAGIC = 0x4b504743;	// "CGPK"
+static const uint PACK_VERSION = 1;
+static const uint PACK_ALIGN = 64;
+
+struct pack_header
+{
+	uint				magic;
+	uint				version;
+	uint				count;			// number of entries in the table of contents
+	uint				reserved;
+	unsigned long long	toc_offset;
+};
+
+struct pack_entry
+{
+	char				name[112];		// normalized relative path; entries are sorted by name
+	unsigned long long	offset;			// from the beginning of the file
+	unsigned long long	size;			// excluding the zero padding
+};
+
+// asset names drop leading "./" and "../" and use forward slashes: "../bin/shaders/circ.vert" -> "bin/shaders/circ.vert"
+inline std::string pack_name(const char* path)
+{
+	std::string s(path); for(auto& c : s) if(c == '\\') c = '/';
+	for(;;)
+	{
+		if(s.compare(0, 2, "./") == 0) s.erase(0, 2);
+		else if(s.compare(0, 3, "../") == 0) s.erase(0, 3);
+		else break;
+	}
+	return s;
+}
+
+//*******************************************************************
+struct asset_pack
+{
+	const uchar*		base = nullptr;		// mapped view of the whole file
+	size_t				size = 0;
+	const pack_entry*	toc = nullptr;
+	uint				count = 0;
+#if defined(_WIN32)||defined(_WIN64)
+	HANDLE				file = INVALID_HANDLE_VALUE;
+	HANDLE				mapping = nullptr;
+#endif
+
+	~asset_pack(){ close(); }
+	inline bool is_open() const { return base != nullptr; }
+
+	bool open(const char* path)
+	{
+		close();
+#if defined(_WIN32)||defined(_WIN64)
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr); if(file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER s; GetFileSizeEx(file, &s); size = size_t(s.QuadPart);
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mapping) base = (const uchar*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = ::open(path, O_RDONLY); if(fd < 0) return false;
+		struct stat st; if(fstat(fd, &st) == 0 && st.st_size > 0){ size = size_t(st.st_size); void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0); if(p != MAP_FAILED) base = (const uchar*) p; }
+		::close(fd);	// the mapping stays valid
+#endif
+		if(!base){ printf("[error] Unable to map %s\n", path); close(); return false; }
+
+		// validate the header and the table of contents
+		const pack_header* h = (const pack_header*) base;
+		if(size < sizeof(pack_header) || h->magic != PACK_MAGIC || h->version != PACK_VERSION || h->toc_offset + h->count*sizeof(pack_entry) > size){ printf("[error] %s is not a valid asset pack\n", path); close(); return false; }
+		toc = (const pack_entry*)(base + h->toc_offset);
+		count = h->count;
+		for(uint k = 0; k < count; k++) if(toc[k].offset + toc[k].size >= size){ printf("[error] %s is not a valid asset pack\n", path); close(); return false; }
+		return true;
+	}
+
+	void close()
+	{
+#if defined(_WIN32)||defined(_WIN64)
+		if(base) UnmapViewOfFile(base);
+		if(mapping) CloseHandle(mapping);
+		if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr; file = INVALID_HANDLE_VALUE;
+#else
+		if(base) munmap((void*) base, size);
+#endif
+		base = nullptr; size = 0; toc = nullptr; count = 0;
+	}
+
+	// binary search in the table of contents; nullptr if the pack is closed or lacks the asset
+	const pack_entry* find(const char* path) const
+	{
+		if(!base) return nullptr;
+		std::string name = pack_name(path);
+		const pack_entry* e = std::lower_bound(toc, toc + count, name, [](const pack_entry& a, const std::string& n){ return strcmp(a.name, n.c_str()) < 0; });
+		return e != toc + count && name == e->name ? e : nullptr;
+	}
+
+	// zero-copy view of an asset: the data is zero-terminated, so text assets can be used as strings
+	bool get(const char* path, const uchar*& data, size_t& data_size) const
+	{
+		const pack_entry* e = find(path); if(!e) return false;
+		data = base + e->offset; data_size = size_t(e->size);
+		return true;
+	}
+};
+
+// the pack shared by the whole application; unopened, every lookup falls back to loose files
+inline asset_pack& cg_assets(){ static asset_pack pack; return pack; }
+
+//*******************************************************************
+// pack builder: writes the files under their normalized names
+inline bool build_pack(const char* pack_path, const char* const* files, int count)
+{
+	std::vector<pack_entry> toc(count); std::vector<std::vector<uchar>> blobs(count);
+	for(int k = 0; k < count; k++)
+	{
+		std::string name = pack_name(files[k]); if(name.size() >= sizeof(toc[k].name)){ printf("[error] %s: name is too long for an asset pack\n", files[k]); return false; }
+		FILE* fp = fopen(files[k], "rb"); if(!fp){ printf("[error] Unable to open %s\n", files[k]); return false; }
+		fseek(fp, 0L, SEEK_END); blobs[k].resize(ftell(fp)); fseek(fp, 0L, SEEK_SET);
+		if(!blobs[k].empty()) fread(&blobs[k][0], blobs[k].size(), 1, fp);
+		fclose(fp);
+		memset(toc[k].name, 0, sizeof(toc[k].name)); memcpy(toc[k].name, name.c_str(), name.size());
+		toc[k].size = blobs[k].size();
+	}
+
+	// sort by name for binary search, then lay out the aligned blobs
+	std::vector<int> order(count); for(int k = 0; k < count; k++) order[k] = k;
+	std::sort(order.begin(), order.end(), [&](int a, int b){ return strcmp(toc[a].name, toc[b].name) < 0; });
+	unsigned long long offset = (sizeof(pack_header) + PACK_ALIGN - 1) / PACK_ALIGN*PACK_ALIGN;
+	for(int k : order){ toc[k].offset = offset; offset = (offset + toc[k].size + 1 + PACK_ALIGN - 1) / PACK_ALIGN*PACK_ALIGN; }	// +1 keeps a zero terminator
+
+	FILE* fp = fopen(pack_path, "wb"); if(!fp){ printf("[error] Unable to write %s\n", pack_path); return false; }
+	pack_header h = { PACK_MAGIC, PACK_VERSION, uint(count), 0, offset };
+	std::vector<uchar> zero(PACK_ALIGN, 0);
+	fwrite(&h, sizeof(h), 1, fp);
+	for(int k : order)
+	{
+		fwrite(&zero[0], 1, size_t(toc[k].offset - ftell(fp)), fp);
+		if(!blobs[k].empty()) fwrite(&blobs[k][0], blobs[k].size(), 1, fp);
+	}
+	fwrite(&zero[0], 1, size_t(offset - ftell(fp)), fp);
+	for(int k : order) fwrite(&toc[k], sizeof(pack_entry), 1, fp);
+	bool b = ferror(fp) == 0; fclose(fp);
+
+	if(b) printf("> packed %d assets into %s (%.1f MB)\n", count, pack_path, (offset + count*sizeof(pack_entry)) / 1048576.0);
+	return b;
+}
+
+#endif // __PACK_H__
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+//*******************************************************************
+// work-stealing thread pool: parallel_for() deals each worker a contiguous run of chunks;
+// a worker takes its own chunks from the back and, once out of work, steals from the
+// front of the others, so uneven chunks (e.g., dense regions of an octree) still balance
+struct work_stealing_pool
+{
+	typedef std::function<void(size_t, size_t)> task_t;	// processes [begin,end)
+
+	struct queue_t
+	{
+		std::mutex							mutex;
+		std::deque<std::pair<size_t, size_t>>	chunks;
+	};
+
+	std::vector<std::thread>	threads;
+	std::vector<queue_t*>		queues;			// one per worker; the caller of parallel_for() is worker 0
+	std::mutex					mutex;			// guards task, generation, busy, and quit
+	std::condition_variable		wake, done;
+	const task_t*				task = nullptr;
+	uint						generation = 0;	// bumped per parallel_for() to wake the workers
+	int							busy = 0;		// workers still inside the current parallel_for()
+	bool						quit = false;
+	std::atomic<size_t>			remaining;		// chunks not yet finished
+	std::atomic<size_t>			steals;			// chunks run by a worker other than their owner
+
+	~work_stealing_pool(){ stop(); }
+	inline int size() const { return int(queues.size()); }
+
+	// thread_count includes the calling thread; zero for all hardware threads
+	void start(int thread_count = 0)
+	{
+		stop();
+		if(thread_count <= 0) thread_count = max(1, int(std::thread::hardware_concurrency()));
+		quit = false; generation = 0; steals = 0;
+		for(int k = 0; k < thread_count; k++) queues.push_back(new queue_t);
+		for(int k = 1; k < thread_count; k++) threads.push_back(std::thread(&work_stealing_pool::work, this, k));
+	}
+
+	void stop()
+	{
+		{ std::lock_guard<std::mutex> lock(mutex); quit = true; }
+		wake.notify_all();
+		for(auto& t : threads) t.join();
+		for(auto* q : queues) delete q;
+		threads.clear(); queues.clear();
+	}
+
+	// run f over [0,n) in chunks of grain items; returns when every chunk is done
+	void parallel_for(size_t n, size_t grain, const task_t& f)
+	{
+		if(queues.empty()) start();
+		if(n == 0) return;
+		size_t chunk_count = (n + grain - 1) / grain, w = queues.size();
+		if(w == 1 || chunk_count == 1){ f(0, n); return; }
+
+		for(size_t k = 0; k < w; k++)
+		{
+			size_t first = chunk_count*k / w, last = chunk_count*(k + 1) / w;
+			std::lock_guard<std::mutex> lock(queues[k]->mutex);
+			for(size_t c = first; c < last; c++) queues[k]->chunks.push_back(std::make_pair(c*grain, min((c + 1)*grain, n)));
+		}
+		remaining = chunk_count;
+		{ std::lock_guard<std::mutex> lock(mutex); task = &f; busy = int(w) - 1; generation++; }
+		wake.notify_all();
+
+		run(0, f);
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this](){ return busy == 0; });
+		task = nullptr;
+	}
+
+	// take a chunk from the own queue, or steal one from the others
+	bool pop(int w, std::pair<size_t, size_t>& chunk)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues[w]->mutex);
+			if(!queues[w]->chunks.empty()){ chunk = queues[w]->chunks.back(); queues[w]->chunks.pop_back(); return true; }
+		}
+		for(int k = 1, n = int(queues.size()); k < n; k++)
+		{
+			queue_t* q = queues[(w + k) % n];
+			std::lock_guard<std::mutex> lock(q->mutex);
+			if(!q->chunks.empty()){ chunk = q->chunks.front(); q->chunks.pop_front(); steals++; return true; }
+		}
+		return false;
+	}
+
+	void run(int w, const task_t& f)
+	{
+		trace_scope scope("parallel_for");
+		std::pair<size_t, size_t> chunk;
+		while(remaining > 0 && pop(w, chunk)){ f(chunk.first, chunk.second); remaining--; }
+	}
+
+	void work(int w)
+	{
+		trace_thread_scope thread("pool worker");
+		for(uint seen = 0;;)
+		{
+			const task_t* f;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&](){ return quit || generation != seen; });
+				if(quit) return;
+				seen = generation; f = task;
+			}
+			run(w, *f);
+			{ std::lock_guard<std::mutex> lock(mutex); busy--; }
+			done.notify_one();
+		}
+	}
+};
+
+#endif // __PARALLEL_H__
@@ -67,4 +67,34 @@ struct ring
 struct ring rings[2] = {
 	{6, 1.9f}, //伺
 	{7, 1.6f}, //õռ
-};
\ No newline at end of file
+};
+
+//*******************************************************************
+// astronomical scale: mean radii in km and J2000 orbital elements (JPL approximate elements)
+static const double	KM_PER_AU = 149597870.7;
+static const double	KM_PER_UNIT = 6371.0;	// one scene unit is the radius of the earth at the real scale
+
+struct planet_scale
+{
+	double radius_km;
+	double a;			// semi-major axis in AU
+	double e;			// eccentricity
+	double i;			// inclination to the ecliptic in degrees
+	double node;		// longitude of the ascending node in degrees
+	double peri;		// argument of perihelion in degrees
+	double M0;			// mean anomaly at J2000 in degrees
+	double period;		// sidereal period in years
+	double mass;		// in solar masses
+};
+
+static const planet_scale planet_scales[9] = {
+	{695700.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0},											// sun
+	{2439.7, 0.38709927, 0.20563593, 7.00497902, 48.33076593, 29.12703035, 174.79252722, 0.2408467, 1.6601e-7},	// mercury
+	{6051.8, 0.72333566, 0.00677672, 3.39467605, 76.67984255, 54.92262463, 50.37663232, 0.61519726, 2.4478e-6},	// venus
+	{6371.0, 1.00000261, 0.01671123, -0.00001531, 0.0, 102.93768193, -2.47311027, 1.0000174, 3.0404e-6},			// earth
+	{3389.5, 1.52371034, 0.09339410, 1.84969142, 49.55953891, 286.49683150, 19.39019754, 1.8808158, 3.2272e-7},	// mars
+	{69911.0, 5.20288700, 0.04838624, 1.30439695, 100.47390909, 274.25457074, 19.66796068, 11.862615, 9.5479e-4},	// jupiter
+	{58232.0, 9.53667594, 0.05386179, 2.48599187, 113.66242448, 338.93645383, 317.35536592, 29.447498, 2.8589e-4},	// saturn
+	{25362.0, 19.18916464, 0.04725744, 0.77263783, 74.01692503, 96.93735127, 142.28382821, 84.016846, 4.3662e-5},	// uranus
+	{24622.0, 30.06992276, 0.00859048, 1.77004347, 131.78422574, 273.18053653, 259.91520804, 164.79132, 5.1514e-5}	// neptune
+};
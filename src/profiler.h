@@ -0,0 +1,144 @@
+#pragma once
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+//*******************************************************************
+// frame profiler: each phase of a frame is timed on the CPU with a high-resolution clock and on the
+// GPU with a GL_TIME_ELAPSED query, and optionally counts its vertex and fragment shader invocations
+// with pipeline-statistics queries; the queries are double-buffered, so a frame reads the results of
+// the previous one, which the GPU has finished by then, into rolling statistics
+// timer queries cannot nest: phases follow one another and never overlap
+// phases are also traced as events, whether the profiler is enabled or not
+static const int	PROFILE_BUFFERS = 2;	// query sets in flight
+static const int	PROFILE_HISTORY = 120;	// frames in the rolling statistics
+
+struct rolling_stats
+{
+	double	samples[PROFILE_HISTORY];
+	int		count = 0, next = 0;
+
+	inline void clear(){ count = next = 0; }
+	inline void push(double x){ samples[next] = x; next = (next + 1) % PROFILE_HISTORY; count = min(count + 1, PROFILE_HISTORY); }
+	inline double average() const { double s = 0; for(int k = 0; k < count; k++) s += samples[k]; return count ? s / count : 0; }
+	inline double maximum() const { double m = 0; for(int k = 0; k < count; k++) m = max(m, samples[k]); return m; }
+};
+
+struct profile_phase
+{
+	const char*	name = "";
+	GLuint		queries[PROFILE_BUFFERS][3];	// elapsed time, vertex shader invocations, fragment shader invocations
+	bool		issued[PROFILE_BUFFERS];		// the set has results not read yet
+	std::chrono::high_resolution_clock::time_point	start;
+	rolling_stats	cpu_ms, gpu_ms, vertices, fragments;
+};
+
+struct profiler
+{
+	bool	enabled = false;
+	bool	timer = false;					// GL_TIME_ELAPSED is there (GL 3.3)
+	bool	pipeline_statistics = false;	// counting invocations as well (ARB_pipeline_statistics_query)
+	int		buffer = 0;						// query set of the current frame
+	std::vector<profile_phase>	phases;
+
+	void create(const char* const* names, int count)
+	{
+		phases.resize(count);
+		timer = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+		for(int k = 0; k < count; k++){ phases[k].name = names[k]; glGenQueries(PROFILE_BUFFERS * 3, phases[k].queries[0]); }
+		set_enabled(false, false);
+	}
+
+	void release()
+	{
+		for(auto& p : phases) glDeleteQueries(PROFILE_BUFFERS * 3, p.queries[0]);
+		phases.clear(); enabled = false;
+	}
+
+	// (re)start with empty statistics; without the extension, invocations are not counted
+	void set_enabled(bool on, bool statistics)
+	{
+		if(on && statistics && !GLAD_GL_ARB_pipeline_statistics_query){ printf("[warning] pipeline statistics queries are not supported\n"); statistics = false; }
+		enabled = on; pipeline_statistics = statistics;
+		for(auto& p : phases)
+		{
+			memset(p.issued, 0, sizeof(p.issued));
+			p.cpu_ms.clear(); p.gpu_ms.clear(); p.vertices.clear(); p.fragments.clear();
+		}
+	}
+
+	void begin(int id)
+	{
+		trace_begin(phases[id].name);
+		if(!enabled) return;
+		profile_phase& p = phases[id];
+		if(timer) glBeginQuery(GL_TIME_ELAPSED, p.queries[buffer][0]);
+		if(pipeline_statistics){ glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, p.queries[buffer][1]); glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, p.queries[buffer][2]); }
+		p.issued[buffer] = timer || pipeline_statistics;
+		p.start = std::chrono::high_resolution_clock::now();
+	}
+
+	void end(int id)
+	{
+		trace_end(phases[id].name);
+		if(!enabled) return;
+		profile_phase& p = phases[id];
+		p.cpu_ms.push(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - p.start).count());
+		if(timer) glEndQuery(GL_TIME_ELAPSED);
+		if(pipeline_statistics){ glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB); glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB); }
+	}
+
+	// switch to the other set, and read the results it holds from the previous frame before it is reused
+	void end_frame()
+	{
+		if(!enabled) return;
+		buffer = (buffer + 1) % PROFILE_BUFFERS;
+		for(auto& p : phases)
+		{
+			if(!p.issued[buffer]) continue;
+			GLuint64 v = 0; p.issued[buffer] = false;
+			if(timer){ glGetQueryObjectui64v(p.queries[buffer][0], GL_QUERY_RESULT, &v); p.gpu_ms.push(v / 1e6); }
+			if(!pipeline_statistics) continue;
+			glGetQueryObjectui64v(p.queries[buffer][1], GL_QUERY_RESULT, &v); p.vertices.push(double(v));
+			glGetQueryObjectui64v(p.queries[buffer][2], GL_QUERY_RESULT, &v); p.fragments.push(double(v));
+		}
+	}
+
+	void print() const
+	{
+		printf("> profile of the last %d frames (average/maximum)\n", PROFILE_HISTORY);
+		for(auto& p : phases)
+		{
+			if(p.cpu_ms.count == 0) continue;
+			printf("  %-10s cpu %7.3f/%7.3f ms", p.name, p.cpu_ms.average(), p.cpu_ms.maximum());
+			if(timer) printf("  gpu %7.3f/%7.3f ms", p.gpu_ms.average(), p.gpu_ms.maximum());
+			if(pipeline_statistics) printf("  %10.0f vertices %12.0f fragments", p.vertices.average(), p.fragments.average());
+			printf("\n");
+		}
+	}
+
+	// "phases":{...} with the averages over the rolling window, for the JSON of the benchmark
+	void print_json() const
+	{
+		printf("\"phases\":{");
+		for(size_t k = 0, n = 0; k < phases.size(); k++)
+		{
+			const profile_phase& p = phases[k]; if(p.cpu_ms.count == 0) continue;
+			printf("%s\"%s\":{\"cpu_ms\":%.3f", n++ ? "," : "", p.name, p.cpu_ms.average());
+			if(timer) printf(",\"gpu_ms\":%.3f", p.gpu_ms.average());
+			if(pipeline_statistics) printf(",\"vertices\":%.0f,\"fragments\":%.0f", p.vertices.average(), p.fragments.average());
+			printf("}");
+		}
+		printf("}");
+	}
+};
+
+// times the enclosing block as one phase
+struct profile_scope
+{
+	profiler&	p;
+	int			id;
+	profile_scope(profiler& p, int id) : p(p), id(id) { p.begin(id); }
+	~profile_scope(){ p.end(id); }
+};
+
+#endif // __PROFILER_H__
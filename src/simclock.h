@@ -0,0 +1,44 @@
+#pragma once
+#ifndef __SIMCLOCK_H__
+#define __SIMCLOCK_H__
+
+//*******************************************************************
+// simulation clock: scaled wall-clock time is consumed in fixed steps, so the simulation does not
+// depend on the frame rate; rendering interpolates between the last two steps by the fraction of a
+// step left over, and a frame takes at most max_steps, so a slow frame runs in slow motion instead
+// of owing ever more steps to the next one
+struct sim_clock
+{
+	double	step = 1.0 / 60.0;	// simulated time per fixed step
+	double	scale = 1.0;		// simulated time per real second; negative runs backward
+	bool	paused = false;
+	int		max_steps = 4;		// per frame; time beyond this is dropped
+	double	time = 0;			// simulated time after the latest step
+	double	previous = 0;		// simulated time before the latest step
+	double	accumulator = 0;	// simulated time not stepped yet, in [0,step)
+	double	wall = -1;			// wall-clock time of the previous frame
+	double	frame_time = 0;		// real seconds since the previous frame, e.g., for camera motion
+	double	dropped = 0;		// simulated time given up by bounded catch-up
+
+	inline double direction() const { return scale < 0 ? -1.0 : 1.0; }
+	inline float alpha() const { return float(accumulator / step); }	// interpolation weight of the latest step
+	inline double render_time() const { return previous + (time - previous)*alpha(); }
+
+	inline void reset(double t){ time = previous = t; accumulator = 0; }
+
+	// consume the wall-clock time since the previous frame; returns the number of steps due now
+	int advance(double now)
+	{
+		frame_time = wall < 0 ? 0 : now - wall; wall = now;
+		if(!paused) accumulator += frame_time*fabs(scale);
+		int n = int(accumulator / step);
+		accumulator -= n*step;
+		if(n > max_steps){ dropped += (n - max_steps)*step; n = max_steps; }
+		return n;
+	}
+
+	// take one step; returns its signed length
+	inline double tick(){ double dt = direction()*step; previous = time; time += dt; return dt; }
+};
+
+#endif // __SIMCLOCK_H__
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef __SYNTHETIC_H__
+#define __SYNTHETIC_H__
+
+//*******************************************************************
+// synthetic scenes for stress tests: a sun, planets on Keplerian orbits, moons around the planets,
+// moons of the moons, and rings, generated in the batches of the hard-coded scene at the toy scale;
+// a fixed seed and a generator of our own make the same scene on every platform
+struct synthetic_scene
+{
+	uint	planets = 0;		// zero: no synthetic scene
+	uint	moons = 4;			// per planet
+	uint	submoons = 2;		// per moon
+	uint	ring_every = 4;		// every n-th planet has a ring
+	uint	seed = 1;
+
+	inline size_t bodies() const { return 1 + size_t(planets)*(1 + moons*(1 + submoons)); }
+	inline size_t ring_count() const { return ring_every ? planets / ring_every : 0; }
+
+	// planets for about the given number of bodies with the default moons, e.g., 10, 10k, or 1M
+	static synthetic_scene with_bodies(size_t count)
+	{
+		synthetic_scene s; size_t per_planet = 1 + s.moons*(1 + s.submoons);
+		s.planets = uint(max(size_t(1), (count - min(count, size_t(1)) + per_planet / 2) / per_planet));
+		return s;
+	}
+
+	// the planets spread over a disk with an area of about 8x8 per planet, no smaller than the toy system;
+	// returns the largest distance of a planet from the sun
+	double generate(kepler_batch& planet_orbits, dorbit_batch& spheres, std::vector<uint>& sphere_parents, std::vector<vec4>& sphere_info,
+		dorbit_batch& rings, std::vector<uint>& ring_parents, std::vector<vec4>& ring_info) const
+	{
+		unsigned long long state = seed * 0x9E3779B97F4A7C15ULL + 1;
+		auto uniform = [&](double lo, double hi){ state = state * 6364136223846793005ULL + 1442695040888963407ULL; return lo + (hi - lo)*double(state >> 11) / double(1ULL << 53); };
+
+		// the sun: planet 0 at the origin, emissive
+		planet_orbits.push_back(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+		spheres.push_back(3.0, 0.1, 0.0, 0.0); sphere_parents.push_back(0); sphere_info.push_back(vec4(0.0f, 0.0f, 0.0f, 0.0f));
+
+		double inner = 6.0, outer = max(44.0, sqrt(inner*inner + 64.0*planets / PI)), extent = inner;
+		for(uint k = 1; k <= planets; k++)
+		{
+			// uniform over the area of the disk; angular speeds fall off as in Kepler's third law from the toy earth
+			// (one draw per statement: the order of evaluating arguments is unspecified)
+			double a = sqrt(uniform(inner*inner, outer*outer)), revolve = 0.9*pow(10.0 / a, 1.5);
+			double e = uniform(0.0, 0.1), incl = uniform(0.0, 0.05), node = uniform(0.0, 2 * PI), peri = uniform(0.0, 2 * PI), M0 = uniform(0.0, 2 * PI);
+			planet_orbits.push_back(a, e, incl, node, peri, M0, revolve);
+			extent = max(extent, a*(1.0 + e));
+
+			double radius = uniform(0.3, 1.8), rotate = uniform(0.05, 0.8);
+			spheres.push_back(radius, rotate, revolve, 0.0); sphere_parents.push_back(k);
+			sphere_info.push_back(vec4(float(1 + k % 8), 1.0f, 0.0f, 0.0f));
+
+			// moons on separate shells, and their moons within half a shell, all with the moon texture;
+			// a moon of a moon follows it as its parent orbit at the summed angular speed
+			for(uint j = 0; j < moons; j++)
+			{
+				double moon_radius = uniform(0.12, 0.27), moon_distance = radius*1.5 + 0.6*(j + 1), moon_revolve = uniform(2.5, 8.0), moon_rotate = uniform(0.3, 0.9);
+				spheres.push_back(moon_radius, moon_rotate, moon_revolve, moon_distance, 0.0, revolve); sphere_parents.push_back(k);
+				sphere_info.push_back(vec4(9.0f, 1.0f, 0.0f, 0.0f));
+				for(uint i = 0; i < submoons; i++)
+				{
+					double r = uniform(0.03, 0.06), spin = uniform(0.3, 0.9), orbit = uniform(8.0, 16.0);
+					spheres.push_back(r, spin, orbit, moon_radius + 0.1*(i + 1), moon_distance, revolve + moon_revolve); sphere_parents.push_back(k);
+					sphere_info.push_back(vec4(9.0f, 1.0f, 0.0f, 0.0f));
+				}
+			}
+
+			if(ring_every && k % ring_every == 0)
+			{
+				double scale = radius*uniform(1.2, 1.4);
+				rings.push_back(scale, 0.0, revolve, 0.0); ring_parents.push_back(k);
+				ring_info.push_back(vec4(float(k / ring_every % 2), 1.0f, 0.0f, 0.0f));
+			}
+		}
+		return extent;
+	}
+};
+
+#endif // __SYNTHETIC_H__
@@ -0,0 +1,210 @@
+#pragma once
+
+//*******************************************************************
+// BC1 (DXT1) texture cache: decoded layers are block-compressed with a full mip
+// chain on first load and stored next to their sources, keyed by a hash of the
+// source file and layer size; later runs upload the blocks without any JPEG decode,
+// and take the placeholder color of the layer from the header alone
+
+static const uint BC1_CACHE_MAGIC = 0x43314342;	// "BC1C"
+static const uint BC1_CACHE_VERSION = 2;
+
+struct bc1_cache_header
+{
+	uint				magic;
+	uint				version;
+	unsigned long long	key;		// source hash combined with the layer size
+	int					width;
+	int					height;
+	int					levels;
+	uint				bytes;		// size of the mip chain following the header
+	uchar				color[4];	// average RGB of the layer; the fourth byte is padding
+};
+
+// size of a BC1 mip level; blocks are 4x4 texels of 8 bytes
+inline size_t bc1_level_size(int width, int height){ return size_t((width + 3) / 4)*((height + 3) / 4) * 8; }
+inline int mip_levels(int width, int height){ int n = 1; while(width > 1 || height > 1){ width = max(1, width / 2); height = max(1, height / 2); n++; } return n; }
+inline size_t bc1_chain_size(int width, int height, int levels)
+{
+	size_t s = 0; for(int l = 0; l < levels; l++) s += bc1_level_size(max(1, width >> l), max(1, height >> l)); return s;
+}
+
+//*******************************************************************
+// 64-bit FNV-1a over the file contents; reading is far cheaper than decoding
+inline void hash_bytes(const uchar* data, size_t size, unsigned long long& hash){ for(size_t k = 0; k < size; k++){ hash ^= data[k]; hash *= 1099511628211ULL; } }
+inline bool hash_file(const char* path, unsigned long long& hash)
+{
+	hash = 14695981039346656037ULL;
+	const uchar* data; size_t size; if(cg_assets().get(path, data, size)){ hash_bytes(data, size, hash); return true; }
+
+	FILE* fp = fopen(path, "rb"); if(!fp) return false;
+	uchar buffer[65536]; size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) hash_bytes(buffer, n, hash);
+	fclose(fp);
+	return true;
+}
+
+inline unsigned long long bc1_cache_key(unsigned long long hash, int width, int height)
+{
+	unsigned long long v[] = { BC1_CACHE_VERSION, (unsigned long long) width, (unsigned long long) height };
+	for(unsigned long long x : v){ hash ^= x; hash *= 1099511628211ULL; }
+	return hash;
+}
+
+// cache files live next to their sources, e.g., ../bin/textures/0123456789abcdef.bc1
+// path should hold the directory of the source plus 21 characters
+inline void get_bc1_cache_path(const char* source, unsigned long long key, char* path)
+{
+	const char *s = strrchr(source, '/'), *b = strrchr(source, '\\'); if(b > s) s = b;
+	int dir = s ? int(s - source + 1) : 0;
+	sprintf(path, "%.*s%016llx.bc1", dir, source, key);
+}
+
+//*******************************************************************
+// BC1 encoding
+inline ushort rgb565(const float* c)
+{
+	int r = int(clamp(c[0], 0.0f, 255.0f) * 31 / 255.0f + 0.5f), g = int(clamp(c[1], 0.0f, 255.0f) * 63 / 255.0f + 0.5f), b = int(clamp(c[2], 0.0f, 255.0f) * 31 / 255.0f + 0.5f);
+	return ushort((r << 11) | (g << 5) | b);
+}
+
+inline void rgb888(ushort c, int* rgb){ rgb[0] = ((c >> 11) & 31) * 255 / 31; rgb[1] = ((c >> 5) & 63) * 255 / 63; rgb[2] = (c & 31) * 255 / 31; }
+
+// a solid block: both endpoints equal and all indices zero
+inline void bc1_solid_block(const uchar* rgb, uchar* block)
+{
+	float c[3] = { float(rgb[0]), float(rgb[1]), float(rgb[2]) };
+	ushort e = rgb565(c); memcpy(block, &e, 2); memcpy(block + 2, &e, 2); memset(block + 4, 0, 4);
+}
+
+// encode 16 RGB texels: endpoints span the principal axis of the block colors
+inline void bc1_encode_block(const uchar texels[16][3], uchar* block)
+{
+	float mean[3] = { 0, 0, 0 };
+	for(int i = 0; i < 16; i++) for(int c = 0; c < 3; c++) mean[c] += texels[i][c] / 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };	// xx xy xz yy yz zz
+	for(int i = 0; i < 16; i++)
+	{
+		float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+		cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2]; cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	}
+
+	// power iteration for the principal axis
+	float axis[3] = { 1, 1, 1 };
+	for(int k = 0; k < 8; k++)
+	{
+		float a[3] = { cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2], cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2], cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+		float l = max(max(fabs(a[0]), fabs(a[1])), fabs(a[2])); if(l < 1e-6f) break;
+		for(int c = 0; c < 3; c++) axis[c] = a[c] / l;
+	}
+
+	float tmin = 1e30f, tmax = -1e30f;
+	for(int i = 0; i < 16; i++)
+	{
+		float t = (texels[i][0] - mean[0])*axis[0] + (texels[i][1] - mean[1])*axis[1] + (texels[i][2] - mean[2])*axis[2];
+		tmin = min(tmin, t); tmax = max(tmax, t);
+	}
+	float l2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]; if(l2 < 1e-12f) l2 = 1;
+	float e0[3], e1[3];
+	for(int c = 0; c < 3; c++){ e0[c] = mean[c] + axis[c] * tmax / l2; e1[c] = mean[c] + axis[c] * tmin / l2; }
+
+	ushort c0 = rgb565(e0), c1 = rgb565(e1);
+	if(c0 < c1){ ushort t = c0; c0 = c1; c1 = t; }
+	memcpy(block, &c0, 2); memcpy(block + 2, &c1, 2);
+	if(c0 == c1){ memset(block + 4, 0, 4); return; }
+
+	// four-color mode (c0 > c1): palette c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+	int p[4][3]; rgb888(c0, p[0]); rgb888(c1, p[1]);
+	for(int c = 0; c < 3; c++){ p[2][c] = (2 * p[0][c] + p[1][c]) / 3; p[3][c] = (p[0][c] + 2 * p[1][c]) / 3; }
+
+	uint indices = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		int best = 0, best_d = INT_MAX;
+		for(int k = 0; k < 4; k++)
+		{
+			int dr = texels[i][0] - p[k][0], dg = texels[i][1] - p[k][1], db = texels[i][2] - p[k][2];
+			int d = dr*dr + dg*dg + db*db; if(d < best_d){ best_d = d; best = k; }
+		}
+		indices |= uint(best) << (i * 2);
+	}
+	memcpy(block + 4, &indices, 4);
+}
+
+// encode a tightly packed RGB image; edge texels are replicated into partial blocks
+inline void bc1_encode_image(const uchar* rgb, int width, int height, uchar* dst)
+{
+	uchar texels[16][3];
+	for(int by = 0; by < height; by += 4) for(int bx = 0; bx < width; bx += 4, dst += 8)
+	{
+		for(int i = 0; i < 16; i++){ int x = min(bx + i % 4, width - 1), y = min(by + i / 4, height - 1); memcpy(texels[i], rgb + (y*width + x) * 3, 3); }
+		bc1_encode_block(texels, dst);
+	}
+}
+
+// box-filter an RGB image to half size
+inline void downsample_image(const uchar* src, int width, int height, uchar* dst)
+{
+	int dw = max(1, width / 2), dh = max(1, height / 2);
+	for(int y = 0; y < dh; y++) for(int x = 0; x < dw; x++)
+	{
+		int x0 = min(x * 2, width - 1), x1 = min(x * 2 + 1, width - 1), y0 = min(y * 2, height - 1), y1 = min(y * 2 + 1, height - 1);
+		for(int c = 0; c < 3; c++) dst[(y*dw + x) * 3 + c] = uchar((src[(y0*width + x0) * 3 + c] + src[(y0*width + x1) * 3 + c] + src[(y1*width + x0) * 3 + c] + src[(y1*width + x1) * 3 + c] + 2) / 4);
+	}
+}
+
+// encode the full mip chain of an RGB image into dst of bc1_chain_size() bytes
+inline void bc1_encode_mips(const uchar* rgb, int width, int height, uchar* dst)
+{
+	std::vector<uchar> a, b; const uchar* level = rgb;
+	for(int l = 0, levels = mip_levels(width, height); l < levels; l++)
+	{
+		int w = max(1, width >> l), h = max(1, height >> l);
+		bc1_encode_image(level, w, h, dst); dst += bc1_level_size(w, h);
+		if(l + 1 == levels) break;
+		b.resize(max(1, w / 2)*max(1, h / 2) * 3);
+		downsample_image(level, w, h, &b[0]); a.swap(b); level = &a[0];
+	}
+}
+
+//*******************************************************************
+// cache files: header followed by the mip chain
+inline bool read_bc1_cache_header(FILE* fp, unsigned long long key, int width, int height, bc1_cache_header& h)
+{
+	return fread(&h, sizeof(h), 1, fp) == 1 && h.magic == BC1_CACHE_MAGIC && h.version == BC1_CACHE_VERSION && h.key == key && h.width == width && h.height == height
+		&& h.levels == mip_levels(width, height) && h.bytes == bc1_chain_size(width, height, h.levels);
+}
+
+inline uchar* load_bc1_cache(const char* path, unsigned long long key, int width, int height, size_t& bytes)
+{
+	FILE* fp = fopen(path, "rb"); if(!fp) return nullptr;
+	bc1_cache_header h; uchar* data = nullptr;
+	if(read_bc1_cache_header(fp, key, width, height, h))
+	{
+		data = (uchar*) malloc(h.bytes);
+		if(fread(data, h.bytes, 1, fp) != 1){ free(data); data = nullptr; }
+		else bytes = h.bytes;
+	}
+	fclose(fp);
+	return data;
+}
+
+// the average color alone, for the placeholder of a layer before its blocks are streamed in
+inline bool load_bc1_cache_color(const char* path, unsigned long long key, int width, int height, uchar* rgb)
+{
+	FILE* fp = fopen(path, "rb"); if(!fp) return false;
+	bc1_cache_header h; bool b = read_bc1_cache_header(fp, key, width, height, h);
+	if(b) memcpy(rgb, h.color, 3);
+	fclose(fp);
+	return b;
+}
+
+inline bool save_bc1_cache(const char* path, unsigned long long key, int width, int height, const uchar* color, const uchar* data, size_t bytes)
+{
+	FILE* fp = fopen(path, "wb"); if(!fp){ printf("[warning] Unable to write %s\n", path); return false; }
+	bc1_cache_header h = { BC1_CACHE_MAGIC, BC1_CACHE_VERSION, key, width, height, mip_levels(width, height), uint(bytes), { color[0], color[1], color[2], 0 } };
+	bool b = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(data, bytes, 1, fp) == 1;
+	fclose(fp); if(!b) remove(path);
+	return b;
+}
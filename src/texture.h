@@ -0,0 +1,485 @@
+#pragma once
+
+//*******************************************************************
+// bilinear resampling of an RGB image into a tightly packed dst_width*dst_height image
+inline void resample_image(const uchar* src, int width, int height, int stride, uchar* dst, int dst_width, int dst_height)
+{
+	if(width == dst_width && height == dst_height){ for(int y = 0; y < height; y++) memcpy(dst + y*dst_width * 3, src + y*stride, width * 3); return; }
+
+	float sx = width / float(dst_width), sy = height / float(dst_height);
+	for(int y = 0; y < dst_height; y++)
+	{
+		float fy = clamp((y + 0.5f)*sy - 0.5f, 0.0f, float(height - 1));
+		int y0 = int(fy), y1 = min(y0 + 1, height - 1); float ty = fy - y0;
+		const uchar *r0 = src + y0*stride, *r1 = src + y1*stride;
+		for(int x = 0; x < dst_width; x++)
+		{
+			float fx = clamp((x + 0.5f)*sx - 0.5f, 0.0f, float(width - 1));
+			int x0 = int(fx), x1 = min(x0 + 1, width - 1); float tx = fx - x0;
+			for(int c = 0; c < 3; c++)
+			{
+				float top = r0[x0 * 3 + c] * (1 - tx) + r0[x1 * 3 + c] * tx;
+				float bottom = r1[x0 * 3 + c] * (1 - tx) + r1[x1 * 3 + c] * tx;
+				dst[(y*dst_width + x) * 3 + c] = uchar(top*(1 - ty) + bottom*ty + 0.5f);
+			}
+		}
+	}
+}
+
+// average color of a tightly packed RGB image
+inline void average_image_color(const uchar* src, size_t texels, uchar* rgb)
+{
+	unsigned long long sum[3] = { 0, 0, 0 };
+	for(size_t k = 0; k < texels; k++) for(int c = 0; c < 3; c++) sum[c] += src[k * 3 + c];
+	for(int c = 0; c < 3; c++) rgb[c] = texels ? uchar((sum[c] + texels / 2) / texels) : 0;
+}
+
+//*******************************************************************
+// stb_image readers that decode straight from the asset pack when the image is there
+inline uchar* load_asset_image(const char* path, int* width, int* height, int* comp, int req_comp)
+{
+	const uchar* data; size_t size; if(cg_assets().get(path, data, size)) return stbi_load_from_memory(data, int(size), width, height, comp, req_comp);
+	return stbi_load(path, width, height, comp, req_comp);
+}
+
+inline bool asset_image_info(const char* path, int* width, int* height, int* comp)
+{
+	const uchar* data; size_t size; if(cg_assets().get(path, data, size)) return stbi_info_from_memory(data, int(size), width, height, comp) != 0;
+	return stbi_info(path, width, height, comp) != 0;
+}
+
+//*******************************************************************
+// bytes held by decoded images, with the high-water mark reached while loading
+struct memory_counter
+{
+	std::atomic<size_t>	current;
+	std::atomic<size_t>	peak;
+
+	memory_counter(){ current = 0; peak = 0; }
+	void add(size_t n){ size_t c = current += n, p = peak; while(c > p && !peak.compare_exchange_weak(p, c)); }
+	void sub(size_t n){ current -= n; }
+};
+
+//*******************************************************************
+// decoded texture layer ready for upload on the GL thread; owns exactly one buffer, so it moves but never copies
+// (VS2013 generates no move members, hence the hand-written ones)
+struct image_t
+{
+	uchar*		pixels = nullptr;	// tightly packed RGB of width*height, bottom row first; or a BC1 mip chain
+	bool		from_stbi = false;	// pixels is the decoder's own buffer
+	bool		bc1 = false;		// pixels holds BC1 blocks of all mip levels
+	bool		cached = false;		// the blocks came from the texture cache without decoding
+	int			width = 0;
+	int			height = 0;
+	double		decode_time = 0;	// seconds spent on a worker for decoding, resampling and encoding
+
+	image_t(){}
+	image_t(image_t&& other){ *this = std::move(other); }
+	~image_t(){ release(); }
+	image_t& operator=(image_t&& other)
+	{
+		if(this == &other) return *this;
+		release();
+		pixels = other.pixels; from_stbi = other.from_stbi; bc1 = other.bc1; cached = other.cached;
+		width = other.width; height = other.height; decode_time = other.decode_time;
+		other.pixels = nullptr;
+		return *this;
+	}
+	image_t(const image_t&) = delete;
+	image_t& operator=(const image_t&) = delete;
+
+	inline size_t size() const { return bc1 ? bc1_chain_size(width, height, mip_levels(width, height)) : size_t(width)*height * 3; }
+	void release(memory_counter* counter = nullptr)
+	{
+		if(!pixels) return;
+		if(from_stbi) stbi_image_free(pixels); else free(pixels);
+		if(counter) counter->sub(size());
+		pixels = nullptr;
+	}
+};
+
+// decode an image straight into the upload layout of width*height: stb_image flips rows while
+// decoding (stbi_set_flip_vertically_on_load), so a layer of the array size is uploaded from the
+// decoder's buffer as-is, and only smaller images are resampled into a second buffer
+inline bool decode_image(const char* path, int width, int height, image_t& image, memory_counter* counter = nullptr)
+{
+	int w, h, comp;
+	uchar* pimage0 = load_asset_image(path, &w, &h, &comp, 3); if(!pimage0){ printf("[error] Unable to load %s\n", path); return false; }
+	if(counter) counter->add(size_t(w)*h * 3);
+
+	image.width = width;
+	image.height = height;
+	if(w == width && h == height){ image.pixels = pimage0; image.from_stbi = true; return true; }
+
+	image.pixels = (uchar*) malloc(image.size()); if(counter) counter->add(image.size());
+	resample_image(pimage0, w, h, w * 3, image.pixels, width, height);
+	stbi_image_free(pimage0); if(counter) counter->sub(size_t(w)*h * 3);
+	return true;
+}
+
+// take the BC1 mip chain of an image from the texture cache, or decode, encode and store it
+inline bool decode_image_bc1(const char* path, int width, int height, image_t& image, memory_counter* counter = nullptr)
+{
+	unsigned long long hash; if(!hash_file(path, hash)){ printf("[error] Unable to load %s\n", path); return false; }
+	unsigned long long key = bc1_cache_key(hash, width, height);
+	std::vector<char> cache_path(strlen(path) + 32); get_bc1_cache_path(path, key, &cache_path[0]);
+
+	size_t bytes = 0;
+	uchar* blocks = load_bc1_cache(&cache_path[0], key, width, height, bytes);
+	if(!blocks)
+	{
+		image_t rgb; if(!decode_image(path, width, height, rgb, counter)) return false;
+		bytes = bc1_chain_size(width, height, mip_levels(width, height));
+		blocks = (uchar*) malloc(bytes); if(counter) counter->add(bytes);
+		bc1_encode_mips(rgb.pixels, width, height, blocks);
+		uchar color[3]; average_image_color(rgb.pixels, size_t(width)*height, color);
+		rgb.release(counter);
+		save_bc1_cache(&cache_path[0], key, width, height, color, blocks, bytes);
+	}
+	else
+	{
+		image.cached = true;
+		if(counter) counter->add(bytes);
+	}
+
+	image.pixels = blocks;
+	image.bc1 = true;
+	image.width = width;
+	image.height = height;
+	return true;
+}
+
+// average color of a layer from the header of its BC1 cache without reading the blocks; false before the cache exists
+inline bool load_cached_color(const char* path, int width, int height, uchar* rgb)
+{
+	unsigned long long hash; if(!hash_file(path, hash)) return false;
+	unsigned long long key = bc1_cache_key(hash, width, height);
+	std::vector<char> cache_path(strlen(path) + 32); get_bc1_cache_path(path, key, &cache_path[0]);
+	return load_bc1_cache_color(&cache_path[0], key, width, height, rgb);
+}
+
+// read only the image headers to find the common layer size of an array texture
+inline ivec2 get_texture_array_size(const char* const* paths, int count)
+{
+	ivec2 size(0, 0);
+	for(int k = 0; k < count; k++)
+	{
+		int width, height, comp; if(!asset_image_info(paths[k], &width, &height, &comp)){ printf("[error] Unable to load %s\n", paths[k]); return ivec2(0, 0); }
+		size = ivec2(max(size.x, width), max(size.y, height));
+	}
+	return size;
+}
+
+//*******************************************************************
+// streaming texture uploads through a ring of pixel buffer objects: the GL thread
+// copies into a PBO and glTexSubImage*() returns without waiting for the transfer
+struct pbo_uploader
+{
+	static const int RING = 3;
+	GLuint		buffers[RING];
+	GLsync		fences[RING];	// last transfer from each persistent slot
+	uchar*		mapped[RING];	// persistent mappings; nullptr when orphaning
+	GLsizeiptr	capacity = 0;	// bytes per slot
+	int			slot = 0;
+
+	pbo_uploader(){ memset(buffers, 0, sizeof(buffers)); memset(fences, 0, sizeof(fences)); memset(mapped, 0, sizeof(mapped)); }
+
+	// (re)allocate the ring so that each slot holds at least size bytes
+	void reserve(GLsizeiptr size)
+	{
+		if(size <= capacity) return;
+		release();
+		capacity = size;
+		glGenBuffers(RING, buffers);
+		for(int k = 0; k < RING; k++)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[k]);
+			if(GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)	// persistently mapped: no map/unmap per upload
+			{
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+				mapped[k] = (uchar*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags);
+			}
+			else glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// the next slot can be staged without waiting: its last transfer is done, polled with a zero timeout
+	bool slot_free()
+	{
+		if(!fences[slot]) return true;
+		if(glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return false;
+		glDeleteSync(fences[slot]); fences[slot] = 0;
+		return true;
+	}
+
+	// copy data into the next slot of the ring and leave it bound for glTex*Image*(); callers stage only
+	// after slot_free(), so copying never waits for the GPU
+	int stage(const void* data, GLsizeiptr size)
+	{
+		reserve(size);
+		int s = slot; slot = (slot + 1) % RING;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[s]);
+		if(mapped[s])
+		{
+			assert(!fences[s]);	// slot_free() retired the last transfer from the slot
+			memcpy(mapped[s], data, size);
+		}
+		else
+		{
+			// orphan the previous storage so that mapping never waits for the GPU
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+			void* p = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if(p){ memcpy(p, data, size); glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER); }
+		}
+		return s;
+	}
+
+	// fence the transfers issued from a staged slot
+	void finish(int s)
+	{
+		if(mapped[s]) fences[s] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// upload a tightly packed RGB image into a layer of an array texture
+	void upload(GLuint texture, int layer, int width, int height, const uchar* pixels)
+	{
+		int s = stage(pixels, GLsizeiptr(width)*height * 3);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);	// layers are tightly packed
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, nullptr); // source: offset 0 of the bound PBO
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		finish(s);
+	}
+
+	// upload a BC1 mip chain into a layer of an array texture, all levels from one slot
+	void upload_bc1(GLuint texture, int layer, int width, int height, const uchar* blocks)
+	{
+		int levels = mip_levels(width, height);
+		int s = stage(blocks, GLsizeiptr(bc1_chain_size(width, height, levels)));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		for(int l = 0, offset = 0; l < levels; l++)
+		{
+			int w = max(1, width >> l), h = max(1, height >> l), size = int(bc1_level_size(w, h));
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, w, h, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, size, (const void*)(size_t)offset);
+			offset += size;
+		}
+		finish(s);
+	}
+
+	void release()
+	{
+		if(!capacity) return;
+		for(int k = 0; k < RING; k++)
+		{
+			if(fences[k]) glDeleteSync(fences[k]);
+			if(mapped[k]){ glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[k]); glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER); }
+			fences[k] = 0; mapped[k] = nullptr;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(RING, buffers);
+		capacity = 0;
+	}
+};
+
+//*******************************************************************
+// background texture streaming: array textures start as neutral gray layers, which take the average
+// colors stored in the texture cache as soon as the workers have read them, and the layers are swapped
+// in on the GL thread as workers finish decoding; the GL thread never decodes or reads files
+struct texture_streamer
+{
+	struct job_t
+	{
+		const char*	path;
+		GLuint		texture;	// target array texture
+		bool		bc1;		// the array is BC1-compressed and filled from the texture cache
+		int			layer;
+		ivec2		size;		// layer size of the target array
+		image_t		image;
+		uchar		color[3];	// cached average color, valid once the job is in colored
+		bool		uploaded = false;
+
+		job_t(const char* path, GLuint texture, bool bc1, int layer, ivec2 size) : path(path), texture(texture), bc1(bc1), layer(layer), size(size) {}
+		job_t(job_t&& other) : path(other.path), texture(other.texture), bc1(other.bc1), layer(other.layer), size(other.size), image(std::move(other.image)), uploaded(other.uploaded) { memcpy(color, other.color, 3); }
+	};
+
+	std::vector<job_t>			jobs;
+	std::vector<std::thread>	threads;
+	std::atomic<int>			next;		// next job to be taken by a worker
+	std::atomic<int>			next_color;	// next job whose cached color is looked up by a worker
+	std::mutex					mutex;		// guards ready and colored
+	std::vector<int>			ready;		// decoded jobs waiting for upload
+	std::vector<int>			colored;	// jobs whose cached color waits to fill their layers
+	pbo_uploader				uploader;
+	memory_counter				memory;		// decoded bytes resident between decode and upload
+	size_t						uploaded = 0;
+	std::chrono::high_resolution_clock::time_point start_time;
+	double						wall_time = 0;	// seconds from start() to the last upload
+
+	~texture_streamer(){ stop(); }	// the jobs free their images
+	inline bool pending() const { return uploaded < jobs.size(); }
+
+	// create an array texture whose layers are filled with a neutral gray, and queue its images;
+	// a BC1 array falls back to RGB8 when S3TC is not supported
+	GLuint add_array(const char* const* paths, int count, bool bc1 = false)
+	{
+		ivec2 size = get_texture_array_size(paths, count); if(size.x == 0) return 0;
+		if(bc1 && !GLAD_GL_EXT_texture_compression_s3tc){ printf("[warning] S3TC is not supported; textures are not compressed\n"); bc1 = false; }
+		std::vector<uchar> colors(count * 3, 128);
+		GLuint texture = bc1 ? create_array_bc1(size, &colors[0], count) : create_array(size, &colors[0], count);
+		for(int k = 0; k < count; k++) jobs.push_back(job_t(paths[k], texture, bc1, k, size));
+		return texture;
+	}
+
+	// RGB8 array; mipmaps are generated from the solid layers right away
+	GLuint create_array(ivec2 size, const uchar* colors, int count)
+	{
+		GLuint texture; glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8 /* GL_RGB for legacy GL */, size.x, size.y, count, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+
+		std::vector<uchar> solid(size.x*size.y * 3);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);	// layers are tightly packed
+		for(int k = 0; k < count; k++)
+		{
+			for(size_t i = 0; i < solid.size(); i += 3) memcpy(&solid[i], colors + k * 3, 3);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, k, size.x, size.y, 1, GL_RGB, GL_UNSIGNED_BYTE, &solid[0]);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+		// configure texture parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		return texture;
+	}
+
+	// BC1 array with every mip level filled with solid blocks; compressed levels cannot be generated on the GPU
+	GLuint create_array_bc1(ivec2 size, const uchar* colors, int count)
+	{
+		GLuint texture; glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+		std::vector<uchar> blocks;
+		for(int l = 0, levels = mip_levels(size.x, size.y); l < levels; l++)
+		{
+			int w = max(1, size.x >> l), h = max(1, size.y >> l); size_t layer_size = bc1_level_size(w, h);
+			blocks.resize(layer_size*count);
+			for(int k = 0; k < count; k++) for(size_t i = 0; i < layer_size; i += 8) bc1_solid_block(colors + k * 3, &blocks[k*layer_size + i]);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, w, h, count, 0, GLsizei(blocks.size()), &blocks[0]);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		return texture;
+	}
+
+	// fill every mip level of a BC1 layer with the solid blocks of its cached color
+	void fill_layer_bc1(const job_t& j)
+	{
+		std::vector<uchar> blocks(bc1_level_size(j.size.x, j.size.y));
+		bc1_solid_block(j.color, &blocks[0]); for(size_t i = 8; i < blocks.size(); i += 8) memcpy(&blocks[i], &blocks[0], 8);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, j.texture);
+		for(int l = 0, levels = mip_levels(j.size.x, j.size.y); l < levels; l++)
+		{
+			int w = max(1, j.size.x >> l), h = max(1, j.size.y >> l);
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, j.layer, w, h, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GLsizei(bc1_level_size(w, h)), &blocks[0]);
+		}
+	}
+
+	// launch workers that decode, flip, and resample queued images concurrently
+	void start(int thread_count = 0)
+	{
+		if(thread_count <= 0) thread_count = max(1, int(std::thread::hardware_concurrency()));
+		thread_count = min(thread_count, int(jobs.size()));
+		start_time = std::chrono::high_resolution_clock::now();
+		stbi_set_flip_vertically_on_load(true);	// global in stb_image; set before any worker decodes
+		next = 0; next_color = 0;
+		for(int k = 0; k < thread_count; k++) threads.push_back(std::thread(&texture_streamer::work, this));
+	}
+
+	void work()
+	{
+		typedef std::chrono::high_resolution_clock clock;
+		trace_thread_scope thread("texture loader");
+
+		// the cached colors first: a hash and a header per layer, far cheaper than any decode
+		for(int k = next_color++; k < int(jobs.size()); k = next_color++)
+		{
+			job_t& j = jobs[k];
+			if(!j.bc1 || !load_cached_color(j.path, j.size.x, j.size.y, j.color)) continue;
+			std::lock_guard<std::mutex> lock(mutex);
+			colored.push_back(k);
+		}
+
+		for(int k = next++; k < int(jobs.size()); k = next++)
+		{
+			clock::time_point t0 = clock::now();
+			job_t& j = jobs[k]; trace_scope scope(j.path);
+			if(j.bc1) decode_image_bc1(j.path, j.size.x, j.size.y, j.image, &memory);
+			else decode_image(j.path, j.size.x, j.size.y, j.image, &memory);
+			j.image.decode_time = std::chrono::duration<double>(clock::now() - t0).count();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.push_back(k);	// a failed image is still reported so that streaming finishes
+		}
+	}
+
+	// fill layers with their cached colors, and upload the layers finished since the last call; call once
+	// per frame on the GL thread; at most one pass over the ring per frame, and only into free slots, so
+	// staging never waits for the GPU; the remaining layers go back to the front of the queue for the next frame
+	void update()
+	{
+		std::vector<int> done, solid;
+		{ std::lock_guard<std::mutex> lock(mutex); done.swap(ready); solid.swap(colored); }
+		if(done.empty() && solid.empty()) return;
+
+		trace_scope scope("upload textures");
+		for(int k : solid) if(!jobs[k].uploaded) fill_layer_bc1(jobs[k]);	// a layer already streamed in keeps its image
+
+		std::set<GLuint> touched;
+		size_t n = 0;
+		for(int staged = 0; n < done.size(); n++)
+		{
+			job_t& j = jobs[done[n]];
+			if(!j.image.pixels){ uploaded++; continue; }	// keep the placeholder
+			if(staged == pbo_uploader::RING || !uploader.slot_free()) break;
+			staged++; uploaded++; j.uploaded = true;
+			if(j.image.bc1) uploader.upload_bc1(j.texture, j.layer, j.size.x, j.size.y, j.image.pixels);
+			else uploader.upload(j.texture, j.layer, j.size.x, j.size.y, j.image.pixels);
+			if(!j.image.bc1) touched.insert(j.texture);	// BC1 layers come with their own mip chain
+			j.image.release(&memory);	// the PBO holds its own copy now
+		}
+		for(GLuint texture : touched){ glBindTexture(GL_TEXTURE_2D_ARRAY, texture); glGenerateMipmap(GL_TEXTURE_2D_ARRAY); }
+		if(n < done.size()){ std::lock_guard<std::mutex> lock(mutex); ready.insert(ready.begin(), done.begin() + n, done.end()); }
+
+		if(!pending())
+		{
+			wall_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+			release();
+		}
+	}
+
+	// stop the workers and free the upload ring; call on the GL thread
+	void release()
+	{
+		stop();
+		uploader.release();
+	}
+
+	// wait for the workers; queued jobs not yet taken are abandoned
+	void stop()
+	{
+		next = next_color = int(jobs.size());
+		for(auto& t : threads) t.join();
+		if(!threads.empty()) stbi_set_flip_vertically_on_load(false);
+		threads.clear();
+	}
+};
@@ -0,0 +1,128 @@
+#pragma once
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+//*******************************************************************
+// event trace: every thread records begin/end markers into a ring of its own, which only that thread
+// writes, so recording takes a clock read and a store without locks; the rings are linked into a list
+// once with a compare-and-swap, and dump() writes the events they still hold as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev), one track per ring; a thread that releases its ring on exit
+// (trace_thread_scope) hands it to the next new thread, so restarted pools reuse their rings
+// names must outlive the trace, e.g., string literals or static paths, and are written without escaping
+#ifdef _MSC_VER
+	#define TRACE_THREAD_LOCAL __declspec(thread)	// VS2013 has no thread_local
+#else
+	#define TRACE_THREAD_LOCAL __thread
+#endif
+
+static const size_t	TRACE_EVENTS = 1 << 16;	// per thread; older events are overwritten
+
+struct trace_event
+{
+	const char*	name;
+	long long	time;	// nanoseconds since the trace started
+	char		phase;	// 'B' or 'E'
+};
+
+struct trace_thread
+{
+	trace_event			events[TRACE_EVENTS];
+	std::atomic<size_t>	count;		// events ever written; the ring holds the last TRACE_EVENTS
+	std::atomic<bool>	in_use;		// owned by a running thread
+	std::atomic<const char*>	name;	// read by dump() on another thread
+	int					id;
+	trace_thread*		next = nullptr;
+};
+
+struct trace_log
+{
+	std::atomic<bool>			enabled;
+	std::atomic<trace_thread*>	threads;	// pushed to the front, never removed until exit, but reused
+	std::atomic<int>			thread_count;
+	std::chrono::steady_clock::time_point	start;
+
+	trace_log(){ enabled = true; threads = nullptr; thread_count = 0; start = std::chrono::steady_clock::now(); }
+	~trace_log(){ for(trace_thread* t = threads, *n; t; t = n){ n = t->next; delete t; } }	// at exit, after every thread joined
+
+	static trace_thread*& current(){ static TRACE_THREAD_LOCAL trace_thread* t = nullptr; return t; }
+
+	// the ring of the calling thread on its first event: a released one, or a new one linked into the list
+	trace_thread* local()
+	{
+		trace_thread*& t = current();
+		if(t) return t;
+		for(trace_thread* r = threads.load(); r; r = r->next)
+		{
+			bool expected = false;
+			if(r->in_use.compare_exchange_strong(expected, true)){ r->name = nullptr; return t = r; }
+		}
+		t = new trace_thread; t->count = 0; t->in_use = true; t->name = nullptr; t->id = thread_count++;
+		t->next = threads.load();
+		while(!threads.compare_exchange_weak(t->next, t));
+		return t;
+	}
+
+	// give the ring of the calling thread to the next new thread; its events stay until overwritten
+	void release_thread()
+	{
+		trace_thread*& t = current(); if(!t) return;
+		t->in_use = false; t = nullptr;
+	}
+
+	inline void record(const char* name, char phase)
+	{
+		if(!enabled.load(std::memory_order_relaxed)) return;
+		trace_thread* t = local(); size_t n = t->count.load(std::memory_order_relaxed);
+		trace_event& e = t->events[n % TRACE_EVENTS];
+		e.name = name; e.phase = phase; e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		t->count.store(n + 1, std::memory_order_release);	// publishes the event to dump()
+	}
+
+	inline void name_thread(const char* name){ local()->name = name; }
+
+	// write the events held by the rings; a thread may keep recording meanwhile, so the slot it writes
+	// next is never copied, and events it could have overwritten during the copy are dropped
+	bool dump(const char* path)
+	{
+		FILE* fp = fopen(path, "w"); if(!fp){ printf("[error] unable to write %s\n", path); return false; }
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		size_t total = 0, tracks = 0; std::vector<trace_event> copy;
+		for(trace_thread* t = threads.load(); t; t = t->next)
+		{
+			// events before first(n) share a slot with event n, which may be half-written while count is n
+			auto first = [](size_t n){ return n + 1 > TRACE_EVENTS ? n + 1 - TRACE_EVENTS : 0; };
+			size_t last = t->count.load(std::memory_order_acquire), from = first(last);
+			copy.clear(); for(size_t k = from; k < last; k++) copy.push_back(t->events[k % TRACE_EVENTS]);
+			size_t now = t->count.load(std::memory_order_acquire), overwritten = first(now) > from ? first(now) - from : 0;
+			const char* name = t->name.load();
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tracks++ ? ",\n" : "", t->id, name ? name : "thread");
+			for(size_t k = min(overwritten, copy.size()); k < copy.size(); k++, total++)
+				fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", copy[k].name, copy[k].phase, copy[k].time / 1000.0, t->id);
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+		printf("> trace of %d events on %d threads written to %s\n", int(total), int(tracks), path);
+		return true;
+	}
+};
+
+inline trace_log& cg_trace(){ static trace_log t; return t; }
+inline void trace_begin(const char* name){ cg_trace().record(name, 'B'); }
+inline void trace_end(const char* name){ cg_trace().record(name, 'E'); }
+
+// names the calling thread for its lifetime, and releases its ring when it exits
+struct trace_thread_scope
+{
+	trace_thread_scope(const char* name){ cg_trace().name_thread(name); }
+	~trace_thread_scope(){ cg_trace().release_thread(); }
+};
+
+// traces the enclosing block
+struct trace_scope
+{
+	const char*	name;
+	trace_scope(const char* name) : name(name) { trace_begin(name); }
+	~trace_scope(){ trace_end(name); }
+};
+
+#endif // __TRACE_H__